@@ -0,0 +1,64 @@
+#include "AllocationScope.h"
+
+#include <algorithm>
+#include <iostream>
+
+AllocationScope::AllocationScope(Allocator &allocator) :
+    m_allocator(allocator)
+{
+}
+
+AllocationScope::~AllocationScope()
+{
+    // a destructor must not throw. Whatever rollback() could not free is beyond saving by then
+    try {
+        rollback();
+    } catch (...) {
+    }
+}
+
+char *AllocationScope::alloc(uint16_t bytes)
+{
+    // make room first, so we can never end up holding memory we didn't record. Growing geometrically keeps that amortised O(1)
+    if (m_allocations.size() == m_allocations.capacity()) {
+        m_allocations.reserve(2 * m_allocations.capacity() + 8);
+    }
+
+    char *address = m_allocator.alloc(bytes);
+    m_allocations.push_back(address);
+    return address;
+}
+
+void AllocationScope::free(char *address)
+{
+    // the most recent allocations are the likeliest to be freed again inside the scope
+    auto found = std::find(m_allocations.rbegin(), m_allocations.rend(), address);
+    if (found != m_allocations.rend()) {
+        *found = m_allocations.back();
+        m_allocations.pop_back();
+    }
+
+    m_allocator.free(address);
+}
+
+void AllocationScope::print()
+{
+    std::cout << "========= Allocation Scope =======" << std::endl << std::endl;
+    std::cout << m_allocations.size() << " allocation(s) recorded" << std::endl << std::endl;
+    m_allocator.print();
+}
+
+void AllocationScope::commit()
+{
+    m_allocations.clear();
+}
+
+void AllocationScope::rollback()
+{
+    // the record is emptied before anything is freed: should a free throw, the rest are left alone rather than freed twice
+    std::vector<char*> allocations;
+    allocations.swap(m_allocations);
+
+    std::sort(allocations.begin(), allocations.end());
+    m_allocator.freeBatch(allocations.data(), allocations.size());
+}
@@ -0,0 +1,37 @@
+#ifndef ALLOCATIONSCOPE_H
+#define ALLOCATIONSCOPE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "Allocator.h"
+
+/*
+ * AllocationScope records every allocation made through it, so a structure that fails to build halfway can be torn down
+ * in one go. rollback() hands everything still recorded to the allocator's freeBatch, in address order so buddies are
+ * released next to each other; commit() keeps it all and just forgets the record. A scope that is neither committed nor
+ * rolled back rolls back when it goes out of scope, swallowing whatever the allocator throws.
+ *
+ *     AllocationScope scope(heap);
+ *     Node *node = build(scope);      // anything taking an Allocator&
+ *     scope.commit();
+ * */
+class AllocationScope : public Allocator
+{
+public:
+    explicit AllocationScope(Allocator &allocator);
+    ~AllocationScope();
+
+    char *alloc(uint16_t bytes) override;
+    void free(char *address) override;
+    void print() override;
+
+    void commit();
+    void rollback();
+
+private:
+    Allocator &m_allocator;
+    std::vector<char*> m_allocations;
+};
+
+#endif // ALLOCATIONSCOPE_H
@@ -1,6 +1,7 @@
 #ifndef ALLOCATOR_H
 #define ALLOCATOR_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 class Allocator
@@ -9,6 +10,14 @@ public:
     virtual char *alloc(uint16_t bytes) = 0;
     virtual void free(char *address) = 0;
     virtual void print() = 0;
+
+    // frees them all, in the order given. Allocators that can do it for less than count separate frees override this
+    virtual void freeBatch(char *const *addresses, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            free(addresses[i]);
+        }
+    }
 };
 
 #endif // ALLOCATOR_H
@@ -0,0 +1,25 @@
+#include "AllocatorHooks.h"
+
+std::atomic<AllocatorHooks*> AllocatorHooksDetail::first(nullptr);
+
+void registerHooks(AllocatorHooks *hooks)
+{
+    hooks->active.store(true, std::memory_order_relaxed);
+
+    // registering again only switches the hooks back on, they are still in the list. Of two threads registering the
+    // same hooks at once, only one gets to link them
+    if (hooks->linked.exchange(true, std::memory_order_relaxed)) {
+        return;
+    }
+
+    // push on the front. The release publishes the callbacks along with the node
+    AllocatorHooks *first = AllocatorHooksDetail::first.load(std::memory_order_relaxed);
+    do {
+        hooks->next = first;
+    } while (!AllocatorHooksDetail::first.compare_exchange_weak(first, hooks, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void unregisterHooks(AllocatorHooks *hooks)
+{
+    hooks->active.store(false, std::memory_order_relaxed);
+}
@@ -0,0 +1,72 @@
+#ifndef ALLOCATORHOOKS_H
+#define ALLOCATORHOOKS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+class BuddyEngine;
+class QuaternaryEngine;
+
+/*
+ * AllocatorHooks lets a profiler follow what the heaps are doing without patching them. Fill in the events you care
+ * about, leave the rest null, and register:
+ *
+ * - onAlloc/onFree for every block handed out by a BuddyAllocator or given back to it, with the bytes it really holds
+ * - onSplit/onCoalesce for every block a BuddyEngine splits into two buddies of 2^k, or merges back from them
+ * - onQuarterSplit/onQuarterCoalesce for every block a QuaternaryEngine splits into four quarters of 2^k, or merges back
+ * - onGrow/onTrim for memory a BuddyAllocator takes from the system or returns to it: its arena, and every mapping
+ *
+ * Registration is lock free and may happen at any time from any thread. Hooks are never unlinked, unregistering only
+ * switches them off, so they have to outlive every allocator (static storage is the usual place). The callbacks run on
+ * the allocating thread, inside whatever lock it holds, and must not allocate from the heap they are watching.
+ *
+ * With nothing registered each event costs a single load and a branch predicted not taken; walking the list is kept
+ * out of line, so it does not crowd the code around it. Defining BUDDY_NO_HOOKS removes even that.
+ * */
+struct AllocatorHooks
+{
+    void (*onAlloc)(void *context, const char *address, size_t bytes);
+    void (*onFree)(void *context, const char *address, size_t bytes);
+    void (*onSplit)(void *context, const BuddyEngine *engine, uint64_t offset, uint8_t k);
+    void (*onCoalesce)(void *context, const BuddyEngine *engine, uint64_t offset, uint8_t k);
+    void (*onQuarterSplit)(void *context, const QuaternaryEngine *engine, uint64_t offset, uint8_t k);
+    void (*onQuarterCoalesce)(void *context, const QuaternaryEngine *engine, uint64_t offset, uint8_t k);
+    void (*onGrow)(void *context, const char *address, size_t bytes);
+    void (*onTrim)(void *context, const char *address, size_t bytes);
+    void *context;
+
+    // owned by the registry, and zero until the first registration
+    std::atomic<bool> active;
+    std::atomic<bool> linked;
+    AllocatorHooks *next;
+};
+
+void registerHooks(AllocatorHooks *hooks);
+void unregisterHooks(AllocatorHooks *hooks);
+
+namespace AllocatorHooksDetail
+{
+    extern std::atomic<AllocatorHooks*> first;
+}
+
+#if defined(BUDDY_NO_HOOKS)
+#  define ALLOCATOR_HOOK(event, ...) ((void)0)
+#else
+#  define ALLOCATOR_HOOK(event, ...) \
+    do { \
+        AllocatorHooks *hooks_ = AllocatorHooksDetail::first.load(std::memory_order_relaxed); \
+        if (__builtin_expect(hooks_ != nullptr, 0)) { \
+            [&]() __attribute__((noinline, cold)) { \
+                std::atomic_thread_fence(std::memory_order_acquire); \
+                for (; hooks_; hooks_ = hooks_->next) { \
+                    if (hooks_->event && hooks_->active.load(std::memory_order_relaxed)) { \
+                        hooks_->event(hooks_->context, __VA_ARGS__); \
+                    } \
+                } \
+            }(); \
+        } \
+    } while (0)
+#endif
+
+#endif // ALLOCATORHOOKS_H
@@ -1,90 +1,92 @@
 #include "BuddyAllocator.h"
+#include "AllocatorHooks.h"
+#include "MemoryPoisoning.h"
 
 #include <iostream>
 #include <string>
 #include <string.h>
 #include <stdlib.h>
+#include <xmmintrin.h>
 
-/*
- * MemoryBlock is a doubly linked list representing available free memory regions of size 2^k. This allows for quick traversal of the
- * available free memory blocks by the buddy allocator.
- * */
-struct MemoryBlock
+namespace
 {
-    union {
-        struct {
-            bool available;
-            uint8_t k;
-        };
-        struct {} list;
+    // the smallest block we hand out is 8 bytes
+    const uint8_t MinOrder = 3;
+
+    struct Block
+    {
+        const char *address;
+        uint32_t size;      // 0 for reserved blocks
     };
-    MemoryBlock *prev, *next;
-};
 
-std::ostream &operator<<(std::ostream &out, const MemoryBlock &block ) {
-    if (block.available) {
-        out << "MemoryBlock( " << &block << ", " << (1 << block.k) << " )";
-    } else {
-        out << "MemoryBlock( " << &block << ", RESERVED )";
+    uint8_t arenaOrder(uint16_t m)
+    {
+        if (m > BuddyAllocator::MaxOrder || m < MinOrder) {
+            throw "Insufficient Memory";
+        }
+        return m;
+    }
+
+    std::ostream &operator<<(std::ostream &out, const Block &block ) {
+        if (block.size) {
+            out << "MemoryBlock( " << (const void*)block.address << ", " << block.size << " )";
+        } else {
+            out << "MemoryBlock( " << (const void*)block.address << ", RESERVED )";
+        }
+        return out;
     }
-    return out;
 }
 
 /*
- * The buddy system relies on the following:
- * - blocks of size 2^k such that 0 <= k <= m
- * - address range from [0, 2^m -1]
- * - blocks are allocated by splitting larger blocks in half
- * - blocks are reclaimed by coalescing two contiguous buddies of equal size back into the larger block it was initially split from
+ * All of the bookkeeping lives in m_engine, beside the arena rather than inside it, so every byte of a reserved block
+ * belongs to the caller and free blocks can be poisoned from end to end.
  * */
 
 BuddyAllocator::BuddyAllocator(uint16_t m) :
     m_order(m),
-    m_blocks(nullptr),
+    m_engine(arenaOrder(m), MinOrder),
     m_buff(nullptr),
-    m_details(false)
+    m_guardThreshold(0),
+    m_guardPlacement(GuardPlacement::After),
+    m_directThreshold(0),
+    m_details(false),
+    m_reportLeaks(false),
+    m_measureLatency(false),
+    m_stats(),
+    m_touched(~uint64_t(0))
 {
-    if (m > 8) {
-        throw "Insufficient Memory";
-    }
-
     // create buffer of size 2^m
     m_buff = (char*) _mm_malloc(1 << m, 1 << m);       // allign our buffer on byte alignments the width of the max block ... should make debugging easier.
     memset(m_buff, 0, 1 << m);
+    POISON_MEMORY(m_buff, 1 << m);
+    ALLOCATOR_HOOK(onGrow, m_buff, size_t(1) << m);
 
-    // create lists to store blocks of size 1, 2, 4, 8, ..., 2^m
-    m_blocks = new MemoryBlock[m+1];
-
-    // note, MemoryBlock serves both as
-    // m_blocks[k].prev --> points to the front element
-    // m_blocks[k].next --> points to the rear element
-
-    // initialize lists
-    for (int k = 3; k < m; ++k ) {
-        m_blocks[k].next = m_blocks[k].prev = &m_blocks[k];
-    }
-
-    m_blocks[m].next = m_blocks[m].prev = (MemoryBlock*)(m_buff);
-    MemoryBlock *block = (MemoryBlock*)(m_buff);
-    block->next = block->prev = &m_blocks[m];
-    block->available = 1;
-    block->k = m;
+    publishStats();
 
-    /// \attention I'm being lazy by creating but ignoring lists for blocks 2^0, 2^1, and 2^2.
-    /// The smallest block size we support is 8 bytes. Keeping the extra lists around means I can
-    /// map block size 2^8 to m_blocks[8]. i thought this was preferable to saying m_blocks[8-3].
+    /// \attention The engine is lazy too: it creates but ignores lists for blocks 2^0, 2^1, and 2^2.
+    /// The smallest block size we support is 8 bytes, anything smaller is rounded up.
 }
 
 BuddyAllocator::~BuddyAllocator()
 {
-    delete [] m_blocks;
+    if (m_reportLeaks) {
+        reportLeaks(std::cerr);
+    }
+
+    for (auto && pair : m_mapped) {
+        unmap(pair.second);
+        ALLOCATOR_HOOK(onTrim, pair.second.base, pair.second.length);
+    }
+
+    UNPOISON_MEMORY(m_buff, 1 << m_order);
+    ALLOCATOR_HOOK(onTrim, m_buff, size_t(1) << m_order);
     _mm_free( m_buff );
 }
 
 namespace
 {
     // https://graphics.stanford.edu/~seander/bithacks.html#RoundUpPowerOf2
-    uint16_t nextPowerOfTwo(uint16_t input) {
+    uint32_t nextPowerOfTwo(uint16_t input) {
 
         uint32_t v = input;
 
@@ -98,168 +100,494 @@ namespace
         return v;
     }
 }
+uint8_t BuddyAllocator::orderFor(uint16_t bytes)
+{
+    // find our block size and its index
+    uint32_t blockSize = nextPowerOfTwo(bytes);
+    uint8_t k = 0;
+    while(blockSize >>= 1) {
+        ++k;
+    }
+
+    return k < MinOrder ? MinOrder : k;
+}
+
+size_t BuddyAllocator::blockSize(const char *address) const
+{
+    if (inArena(address)) {
+        return size_t(1) << m_engine.orderOf(address - m_buff);
+    }
+
+    auto found = m_mapped.find(const_cast<char*>(address));
+    if (found == m_mapped.end()) {
+        throw "Not allocated by this allocator";
+    }
+    return found->second.bytes;
+}
+
 char *BuddyAllocator::alloc(uint16_t bytes)
+{
+    char *address = tryAlloc(bytes);
+    if (!address) {
+        throw "Insufficient Memory!";
+    }
+    return address;
+}
+
+char *BuddyAllocator::tryAlloc(uint16_t bytes)
 {
     if (m_details) {
         std::cout << "*** Allocating " << bytes << " bytes" << std::endl;
     }
 
+    if (m_measureLatency) {
+        m_allocStart = std::chrono::steady_clock::now();
+    }
+
     if (bytes <= 0) {
         throw "Har har har";
     }
 
-    if (bytes >= 256) {
-        throw "Insufficient Memory";
+    if (bypassesArena(bytes)) {
+        char *address = allocMapped(bytes);
+        if (m_measureLatency) {
+            recordLatency();
+            publishStats();
+        }
+        return address;
     }
 
-    bytes += 1; // must account for our boolean flag
-
-    // find our block size and its index
-    uint16_t blockSize = nextPowerOfTwo(bytes);
-    uint16_t k = 0;
-    while(blockSize >>= 1) {
-        ++k;
+    if (bytes > capacity()) {
+        ++m_stats.failures;
+        touched(m_stats.failures);
+        if (m_measureLatency) {
+            recordLatency();
+        }
+        publishStats();
+        return nullptr;
     }
 
-    if (m_details) {
-        std::cout << "   Searching for free block of size " << (1 << k) << std::endl;
+    uint8_t k = orderFor(bytes);
+    uint64_t offset = m_engine.alloc(k);
+
+    if (offset == BuddyEngine::None) {
+        // there are no known available blocks of sufficient size to meet the request
+        if (m_details) {
+            std::cout << "Allocation failed." << std::endl << std::endl;
+        }
+
+        ++m_stats.failures;
+        touched(m_stats.failures);
+        if (m_measureLatency) {
+            recordLatency();
+        }
+        publishStats();
+        return nullptr;
     }
 
-    for (uint8_t j = k; j <= m_order; ++j) {
-        // find smallest available block that sufficient for the request
-        if (m_blocks[j].next != &m_blocks[j]) {
-            // remove free block and update list
-            MemoryBlock *freeBlock = m_blocks[j].next;
-            MemoryBlock *nextBlock = freeBlock->next;
-            m_blocks[j].next = nextBlock;
-            nextBlock->prev = &m_blocks[j];
-            freeBlock->available  = 0;
+    return reserved(offset, bytes);
+}
 
-            if (m_details) {
-                std::cout << "   Found available block: " <<  *freeBlock << std::endl;
-            }
+char *BuddyAllocator::allocNear(uint16_t bytes, const char *near, uint8_t groupOrder)
+{
+    char *address = tryAllocNear(bytes, near, groupOrder);
+    return address ? address : alloc(bytes);
+}
 
-            // do we need to split blocks ?
-            while (j != k) {
-                --j;
+char *BuddyAllocator::tryAllocNear(uint16_t bytes, const char *near, uint8_t groupOrder)
+{
+    if (m_measureLatency) {
+        m_allocStart = std::chrono::steady_clock::now();
+    }
 
-                // if so, split the block and enter the unused half in the available list
-                nextBlock = getBuddy(freeBlock, j);
-                nextBlock->available = 1;
-                nextBlock->k = j;
-                nextBlock->next = nextBlock->prev = &m_blocks[j];
-                m_blocks[j].next = m_blocks[j].prev = nextBlock;
+    // a group member outside the arena has no neighbours to speak of
+    uint64_t offset = BuddyEngine::None;
+    if (near && inArena(near) && bytes > 0 && bytes <= capacity() && !bypassesArena(bytes)) {
+        if (m_details) {
+            std::cout << "*** Allocating " << bytes << " bytes near 0x" << (const void*)near << std::endl;
+        }
 
-                if (m_details) {
-                    std::cout << "      Split required - Creating smaller block: " << *nextBlock << std::endl;
-                }
-            }
+        offset = m_engine.allocWithin(orderFor(bytes), near - m_buff, groupOrder);
+    }
+
+    if (offset == BuddyEngine::None) {
+        ++m_stats.nearMisses;
+        touched(m_stats.nearMisses);
+        if (m_measureLatency) {
+            recordLatency();
+        }
+        publishStats();
+        return nullptr;
+    }
+
+    return reserved(offset, bytes);
+}
 
-            // we've found and reserved our block
-            char *address = toUserSpace(freeBlock);
-            used[freeBlock] = j;
+char *BuddyAllocator::allocGroup(const uint16_t *sizes, const uint16_t *aligns, size_t count, char **parts)
+{
+    if (count == 0) {
+        throw "Har har har";
+    }
 
-            if (m_details) {
-                std::cout << "   Allocation Success - Returning available block: " << *freeBlock << std::endl << std::endl;
+    // the first pass only measures, the second one hands out the parts
+    auto layout = [&](char *address) {
+        uint32_t end = 0;
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t align = aligns ? aligns[i] : 8;
+            end = (end + align - 1) & ~(align - 1);
+            if (address) {
+                parts[i] = address + end;
             }
+            end += sizes[i];
+        }
+        return end;
+    };
 
-            return address;
+    // a block is aligned to its own size, so it only has to be at least as large as the strictest alignment
+    uint32_t strictest = 1;
+    for (size_t i = 0; aligns && i < count; ++i) {
+        if (aligns[i] == 0 || (aligns[i] & (aligns[i] - 1))) {
+            throw "Alignment must be a power of two";
         }
+        strictest = aligns[i] > strictest ? aligns[i] : strictest;
     }
 
-    // there are no known available blocks of sufficient size to meet the request
+    uint32_t bytes = layout(nullptr);
+    bytes = bytes > strictest ? bytes : strictest;
+    if (bytes > 0xffff) {
+        ++m_stats.failures;
+        touched(m_stats.failures);
+        publishStats();
+        throw "Insufficient Memory!";
+    }
+
+    // a mapping only promises 16 bytes, and parts[0] has to stay the address free() knows it by
+    if (strictest > 16 && bypassesArena(bytes)) {
+        throw "Alignment not supported for mapped groups";
+    }
+
+    char *address = alloc(uint16_t(bytes));
+    layout(address);
+    return address;
+}
+
+char *BuddyAllocator::reserved(uint64_t offset, uint16_t bytes)
+{
+    // we've found and reserved our block, only the bytes asked for may be touched
+    uint8_t k = m_engine.orderOf(offset);
+    char *address = m_buff + offset;
+    UNPOISON_MEMORY(address, bytes);
+
+    ++m_stats.usedBlocks[k];
+    m_stats.liveBytes += 1 << k;
+    touched(m_stats.usedBlocks[k]);
+    touched(m_stats.liveBytes);
+    ALLOCATOR_HOOK(onAlloc, address, size_t(1) << k);
+    if (m_measureLatency) {
+        recordLatency();
+    }
+    publishStats();
 
     if (m_details) {
-        std::cout << "No blocks of size >=" << (1<<k) << "available. Allocation failed." << std::endl;
+        std::cout << "   Allocation Success - Returning available block: " << Block{ address, 0 } << std::endl << std::endl;
     }
 
-    throw "Insufficient Memory!";
+    return address;
 }
 
 void BuddyAllocator::free(char *address)
 {
+    release(address);
+    publishStats();
+}
+
+void BuddyAllocator::freeBatch(char *const *addresses, size_t count)
+{
+    // a block that fails to free still leaves the ones before it counted
+    try {
+        for (size_t i = 0; i < count; ++i) {
+            release(addresses[i]);
+        }
+    } catch (...) {
+        publishStats();
+        throw;
+    }
+    publishStats();
+}
+
+void BuddyAllocator::release(char *address)
+{
+    // like free(3)
+    if (!address) {
+        return;
+    }
+
     if (m_details) {
         std::cout << "*** Freeing memory at address: 0x" << (void*)address << std::endl;
     }
-    // remove block from used list
-    MemoryBlock *block = fromUserSpace(address);
-    uint8_t k = used[block];
-    used.erase(block);
+
+    if (!inArena(address)) {
+        freeMapped(address);
+        return;
+    }
+
+    uint8_t k = m_engine.free(address - m_buff);
+    ALLOCATOR_HOOK(onFree, address, size_t(1) << k);
+
+    POISON_MEMORY(address, 1 << k);
+    --m_stats.usedBlocks[k];
+    m_stats.liveBytes -= 1 << k;
+    touched(m_stats.usedBlocks[k]);
+    touched(m_stats.liveBytes);
 
     if (m_details) {
-        std::cout << "   Located at block: " << *block << std::endl;
+        std::cout << std::endl;
     }
+}
 
-    // is buddy available?
-    MemoryBlock *buddy = getBuddy(block, k);
+size_t BuddyAllocator::reportLeaks(std::ostream &out) const
+{
+    size_t leaks[MaxOrder + 1] = {};
+    size_t count = 0, bytes = 0;
+
+    m_engine.forEachBlock([&](uint64_t, uint8_t k, bool available) {
+        if (!available) {
+            ++leaks[k];
+            ++count;
+            bytes += 1 << k;
+        }
+    });
 
-    // combine buddy if:
-    // 1. we're not at the last block
-    // 2. our buddy is available
-    // 3. our buddy is also the same size we are
-    while (k != m_order && buddy->available == 1 && buddy->k == k) {
+    for (auto && pair : m_mapped) {
+        ++count;
+        bytes += pair.second.bytes;
+    }
 
-        if (m_details) {
-            std::cout << "      Coalescing - Reclaiming additional block: " << *buddy << std::endl;
+    if (count == 0) {
+        return 0;
+    }
+
+    out << "========= Leaked Memory =======" << std::endl << std::endl;
+    out << count << " block(s) still reserved, " << bytes << " bytes" << std::endl;
+
+    if (!m_mapped.empty()) {
+        out << "   " << m_mapped.size() << " mapped:";
+        for (auto && pair : m_mapped) {
+            out << " " << (void*)pair.first << " (" << pair.second.bytes << " bytes)";
+        }
+        out << std::endl;
+    }
+
+    for (int k = MaxOrder; k >= 0; --k) {
+        if (leaks[k] == 0) {
+            continue;
         }
 
-        // remove buddy from our free list
-        // 1. point the node behind me, to whatever is in front of me
-        // 2. point the node in front of me, to whatever is behind me
-        buddy->prev->next = buddy->next;
-        buddy->next->prev = buddy->prev;
+        out << "   " << leaks[k] << " x " << (1 << k) << " bytes:";
+        m_engine.forEachBlock([&](uint64_t offset, uint8_t blockOrder, bool available) {
+            if (!available && blockOrder == k) {
+                out << " " << (void*)(m_buff + offset);
+            }
+        });
+        out << std::endl;
+    }
 
-        // bump up block level
-        ++k;
+    out << std::endl;
+    return count;
+}
+
+void BuddyAllocator::guardLargeAllocations(uint16_t threshold, GuardPlacement placement)
+{
+    m_guardThreshold = threshold;
+    m_guardPlacement = placement;
+}
+
+char *BuddyAllocator::realloc(char *address, size_t bytes)
+{
+    // alloc only takes what could fit the arena
+    auto allocAny = [this](size_t bytes) {
+        return bytes <= 0xffff && bytes <= capacity() ? tryAlloc(uint16_t(bytes)) : allocMapped(bytes);
+    };
+
+    if (!address) {
+        return allocAny(bytes);
+    }
+
+    if (bytes == 0) {
+        free(address);
+        return nullptr;
+    }
+
+    if (m_details) {
+        std::cout << "*** Resizing memory at address: 0x" << (void*)address << " to " << bytes << " bytes" << std::endl;
+    }
+
+    size_t old;
+    if (inArena(address)) {
+        uint8_t k = m_engine.orderOf(address - m_buff);
+        old = size_t(1) << k;
+
+        // still fits the block, only what may be touched changes
+        if (bytes <= old && !bypassesArena(bytes)) {
+            UNPOISON_MEMORY(address, bytes);
+            POISON_MEMORY(address + bytes, old - bytes);
+            return address;
+        }
+    } else {
+        auto found = m_mapped.find(address);
+        if (found == m_mapped.end()) {
+            throw "Not allocated by this allocator";
+        }
 
-        if (buddy < block) {
-            block = buddy;
+        MappedRegion region = found->second;
+        old = region.bytes;
+
+        // direct mappings stay mapped however small they get, moving a buffer this large back into the arena is not worth it
+        if (!region.guarded) {
+            try {
+                remap(region, bytes);
+            } catch (const char *) {
+                ++m_stats.failures;
+                touched(m_stats.failures);
+                publishStats();
+                return nullptr;
+            }
+
+            m_stats.mappedBytes += region.length - found->second.length;
+            touched(m_stats.mappedBytes);
+            publishStats();
+
+            // to a profiler a move is the old mapping going away and a new one taking its place
+            ALLOCATOR_HOOK(onFree, address, old);
+            ALLOCATOR_HOOK(onTrim, found->second.base, found->second.length);
+            ALLOCATOR_HOOK(onGrow, region.base, region.length);
+            ALLOCATOR_HOOK(onAlloc, region.address, region.bytes);
+
+            m_mapped.erase(found);
+            m_mapped[region.address] = region;
+            return region.address;
         }
+    }
 
-        buddy = getBuddy(block, k);
+    char *moved = allocAny(bytes);
+    if (!moved) {
+        return nullptr;
     }
 
-    // add newly reclaimed block to the available list
-    block->available = 1;
-    block->k = k;
+    // all of an arena block gets copied, not just what was asked for
+    if (inArena(address)) {
+        UNPOISON_MEMORY(address, old);
+    }
+
+    memcpy(moved, address, old < bytes ? old : bytes);
+    free(address);
+    return moved;
+}
 
-    MemoryBlock *nextBlock = m_blocks[k].next;
-    block->next = nextBlock;
-    nextBlock->prev = block;
+char *BuddyAllocator::allocMapped(size_t bytes)
+{
+    // the guard is for debugging, so it wins
+    bool guarded = m_guardThreshold && bytes >= m_guardThreshold && bytes <= 0xffff;
+
+    MappedRegion region;
+    try {
+        region = guarded ? mapGuarded(uint16_t(bytes), m_guardPlacement) : mapDirect(bytes);
+    } catch (const char *) {
+        ++m_stats.failures;
+        touched(m_stats.failures);
+        publishStats();
+        return nullptr;
+    }
 
-    block->prev = &m_blocks[k];
-    m_blocks[k].next = block;
+    m_mapped[region.address] = region;
+    m_stats.mappedBytes += region.length;
+    touched(m_stats.mappedBytes);
+    publishStats();
+    ALLOCATOR_HOOK(onGrow, region.base, region.length);
+    ALLOCATOR_HOOK(onAlloc, region.address, region.bytes);
 
     if (m_details) {
-        std::cout << "   Free Success - New block available: " << *block << std::endl << std::endl;
+        std::cout << "   " << (guarded ? "Guarded" : "Direct") << " Allocation - Mapped " << region.length << " bytes at: 0x" << (void*)region.base << std::endl << std::endl;
     }
 
-    // a list of size n looks like the following:
-    // [ Head ] --> [ rear ]<-->[ n - 1]<-- ... -->[ 2 ] [ front ]
-    // [ Head ] --> [ newBlock ]<-->[ n ]<-->[ n - 1]<-- ... -->[ 2 ] [ front ]
+    return region.address;
 }
 
-char *BuddyAllocator::toUserSpace(MemoryBlock *block)
+void BuddyAllocator::freeMapped(char *address)
 {
-    return ((char*)block) + 1;
+    auto found = m_mapped.find(address);
+    if (found == m_mapped.end()) {
+        throw "Not allocated by this allocator";
+    }
+
+    unmap(found->second);
+    ALLOCATOR_HOOK(onFree, address, found->second.bytes);
+    ALLOCATOR_HOOK(onTrim, found->second.base, found->second.length);
+    m_stats.mappedBytes -= found->second.length;
+    touched(m_stats.mappedBytes);
+    m_mapped.erase(found);
+
+    if (m_details) {
+        std::cout << "   Free Success - Unmapped allocation" << std::endl << std::endl;
+    }
 }
 
-MemoryBlock *BuddyAllocator::fromUserSpace(char *address)
+void BuddyAllocator::recordLatency()
 {
-    return (MemoryBlock*)(address - 1);
+    uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_allocStart).count();
+
+    uint8_t bucket = 0;
+    while (bucket < LatencyBuckets - 1 && nanos >= (uint64_t(1) << (bucket + 6))) {
+        ++bucket;
+    }
+
+    ++m_stats.latency[bucket];
+    m_stats.latencyNanos += nanos;
+    touched(m_stats.latency[bucket]);
+    touched(m_stats.latencyNanos);
 }
 
-MemoryBlock *BuddyAllocator::getBuddy(MemoryBlock *block, uint8_t k)
+void BuddyAllocator::publishStats()
 {
-    return (MemoryBlock*)((uintptr_t)block ^ (1<<k));
+    // an alloc or free changes a handful of counters, and only those get stored
+    for (uint64_t changed = m_engine.takeChangedOrders(); changed; changed &= changed - 1) {
+        uint8_t k = uint8_t(__builtin_ctzll(changed));
+        m_stats.freeBlocks[k] = uint32_t(m_engine.freeBlocks(k));
+        touched(m_stats.freeBlocks[k]);
+    }
+
+    int largest = m_engine.largestFree();
+    uint32_t largestFree = largest < 0 ? 0 : 1 << largest;
+    if (m_stats.largestFree != largestFree) {
+        m_stats.largestFree = largestFree;
+        touched(m_stats.largestFree);
+    }
+    if (m_stats.splits != m_engine.splits()) {
+        m_stats.splits = m_engine.splits();
+        touched(m_stats.splits);
+    }
+    if (m_stats.coalesces != m_engine.coalesces()) {
+        m_stats.coalesces = m_engine.coalesces();
+        touched(m_stats.coalesces);
+    }
+
+    if (m_touched) {
+        m_published.store(m_stats, m_touched);
+        m_touched = 0;
+    }
 }
 
 void BuddyAllocator::print()
 {
 
     std::cout << "========= Used Memory =======" << std::endl << std::endl;
-    for (auto && pair : used) {
-        std::cout << "{ " << *(pair.first) << " , Data(" << toUserSpace(pair.first) << ") }" << std::endl;
+    m_engine.forEachBlock([&](uint64_t offset, uint8_t, bool available) {
+        if (!available) {
+            std::cout << "{ " << Block{ m_buff + offset, 0 } << " , Data(" << (m_buff + offset) << ") }" << std::endl;
+        }
+    });
+    for (auto && pair : m_mapped) {
+        std::cout << "{ MappedRegion( " << (void*)pair.first << ", " << pair.second.bytes << " ) }" << std::endl;
     }
     std::cout << std::endl;
 
@@ -284,19 +612,21 @@ void BuddyAllocator::print()
     top = bottom = "+";
     middle = "|";
 
-    for (int i = 3; i <= m_order; ++i) {
-        for (MemoryBlock *block = m_blocks[i].prev; block != &m_blocks[i]; block = block->next) {
-            // print available block
-            std::string blockSize = std::to_string(1 << block->k);
-            std::string segment;
-            segment.append(blockSize.size(), '-');
-            segment = leftSegment + segment + rightSegment;
-
-            top += segment;
-            middle += leftUnused + blockSize + rightUnused;
-            bottom += segment;
+    m_engine.forEachBlock([&](uint64_t, uint8_t k, bool available) {
+        if (!available) {
+            return;
         }
-    }
+
+        // print available block
+        std::string blockSize = std::to_string(1 << k);
+        std::string segment;
+        segment.append(blockSize.size(), '-');
+        segment = leftSegment + segment + rightSegment;
+
+        top += segment;
+        middle += leftUnused + blockSize + rightUnused;
+        bottom += segment;
+    });
 
     std::cout << "========= Available Memory =======" << std::endl;
     std::cout << std::endl;
@@ -2,42 +2,164 @@
 #define BUDDYALLOCATOR
 
 #include <stdint.h>
-#include <memory>
+#include <chrono>
 #include <map>
+#include <memory>
+#include <ostream>
 
 #include "Allocator.h"
+#include "BuddyEngine.h"
+#include "MappedRegion.h"
+#include "SeqLock.h"
 
 /*
  * Buddy Allocator manages a contiguous block of 2^m bytes. Implements Knuth's "buddy system" in order to manage block allocation and deallocation.
  * See Knuth's The Art of Programming, Vol 1 for more details.
+ *
+ * The buddy system itself lives in BuddyEngine, which hands out offsets. BuddyAllocator turns those into addresses within its buffer.
  * */
 
-struct MemoryBlock;
-
 class BuddyAllocator : public Allocator
 {
 public:
+    static const uint8_t MaxOrder = 16;   // requests are at most 2^16 - 1 bytes
+    static const uint8_t LatencyBuckets = 12;  // 2^6 ns, 2^7 ns, ..., 2^17 ns and everything slower
+
+    /*
+     * Stats is a snapshot of the heap published after every alloc and free. It can be read from any thread at any time
+     * without taking a lock and without slowing the allocating thread down (see SeqLock). Publishing only stores the
+     * counters an alloc or free actually changed.
+     * */
+    struct Stats
+    {
+        uint32_t freeBlocks[MaxOrder + 1];  // available blocks of size 2^k, indexed by k
+        uint32_t usedBlocks[MaxOrder + 1];  // reserved blocks of size 2^k, indexed by k
+        uint32_t liveBytes;                 // bytes held by reserved blocks
+        uint32_t largestFree;               // size of the largest available block, 0 when the heap is exhausted
+
+        uint64_t splits;
+        uint64_t coalesces;
+        uint64_t failures;                  // allocations that threw for lack of memory
+        uint64_t nearMisses;                // tryAllocNear calls that found no room near and returned nullptr
+        uint64_t mappedBytes;               // mapped outside the arena, for guarded and direct allocations
+
+        // alloc latency, only gathered while measureLatency(true). Failed and mapped allocations and tryAllocNear misses
+        // count too, realloc does not
+        uint64_t latency[LatencyBuckets];   // bucket i counts allocations taking less than 2^(i+6) ns, the last one the rest
+        uint64_t latencyNanos;              // sum of all measured latencies
+    };
+
     BuddyAllocator(uint16_t m);
     ~BuddyAllocator();
 
     char *alloc(uint16_t bytes) override;
-    void free(char *address) override;
+    void free(char *address) override;     // nullptr is ignored
     void print() override;
 
-    void showDetails(bool show) { m_details = show; }
+    // frees them all, publishing the stats once at the end rather than after every block
+    void freeBatch(char *const *addresses, size_t count) override;
+
+    // same as alloc, but returns nullptr instead of throwing when there is no room
+    char *tryAlloc(uint16_t bytes);
+
+    // prefers a block inside the same 2^groupOrder parent block as near, so related objects end up close together
+    char *allocNear(uint16_t bytes, const char *near, uint8_t groupOrder);
+
+    // only looks inside near's 2^groupOrder block, nullptr when there is no room there
+    char *tryAllocNear(uint16_t bytes, const char *near, uint8_t groupOrder);
+
+    /*
+     * Lays count parts out one after another in a single block, part i with sizes[i] bytes aligned to aligns[i] (a power
+     * of two, or 8 when aligns is nullptr), and stores where each one starts in parts. parts[0] is the start of the block,
+     * so free(parts[0]) releases the lot. A group that ends up mapped (see guardLargeAllocations and mapLargeAllocations)
+     * is only 16 byte aligned, so asking such a group for more throws.
+     * */
+    char *allocGroup(const uint16_t *sizes, const uint16_t *aligns, size_t count, char **parts);
+
+    const char *base() const { return m_buff; }
+    uint32_t capacity() const { return 1u << m_order; }
+    uint8_t order() const { return uint8_t(m_order); }
+
+    // the order of the block a request for bytes ends up in
+    static uint8_t orderFor(uint16_t bytes);
+
+    // order of the largest free block in the arena, -1 when there is none. Unlike tryAlloc, asking never counts as a failure
+    int largestFree() const { return m_engine.largestFree(); }
+
+    bool inArena(const char *address) const { return address >= m_buff && address < m_buff + capacity(); }
+
+    /*
+     * Bytes actually held by the allocation at address: its whole block, or what was asked for if it is mapped. For a
+     * block in the arena this only reads the block's own tag, which nothing else writes while it is reserved, so its
+     * owner may ask while another thread allocates and frees.
+     * */
+    size_t blockSize(const char *address) const;
+
+    void showDetails(bool show) { m_details = show; m_engine.showDetails(show); }
+    void measureLatency(bool measure) { m_measureLatency = measure; }
+
+    // allocations of at least threshold bytes get their own mapping with a guard page, 0 turns this off again
+    void guardLargeAllocations(uint16_t threshold, GuardPlacement placement = GuardPlacement::After);
+
+    // allocations of at least threshold bytes bypass the arena and get their own mapping, 0 turns this off again
+    void mapLargeAllocations(uint16_t threshold) { m_directThreshold = threshold; }
+
+    /*
+     * Resizes the allocation at address, like realloc(3): nullptr allocates, 0 bytes frees, and on failure nullptr is
+     * returned and the old allocation stays as it was. Unlike alloc it takes any size; whatever does not fit the arena
+     * (or is at least the mapLargeAllocations threshold) is mapped, and a mapped allocation grows with mremap rather
+     * than by copying.
+     * */
+    char *realloc(char *address, size_t bytes);
+
+    // lists every block still reserved, returns how many there were
+    size_t reportLeaks(std::ostream &out) const;
+    void reportLeaksOnDestruction(bool report) { m_reportLeaks = report; }
+
+    Stats stats() const { return m_published.load(); }
 
 private:
-    char *toUserSpace(MemoryBlock *);
-    MemoryBlock *fromUserSpace(char *);
 
-    MemoryBlock *getBuddy(MemoryBlock *block, uint8_t k);
+    char *reserved(uint64_t offset, uint16_t bytes);
+    void release(char *address);   // free, short of publishing the stats
+
+    bool bypassesArena(size_t bytes) const
+    {
+        return (m_guardThreshold && bytes >= m_guardThreshold) || (m_directThreshold && bytes >= m_directThreshold);
+    }
+
+    char *allocMapped(size_t bytes);
+    void freeMapped(char *address);
+
+    void recordLatency();
+    void publishStats();
+
+    // marks the words of m_stats that field lies in, for publishStats to store
+    template <typename Field>
+    void touched(const Field &field)
+    {
+        size_t offset = reinterpret_cast<const char*>(&field) - reinterpret_cast<const char*>(&m_stats);
+        size_t first = offset / sizeof(uint64_t), last = (offset + sizeof(Field) - 1) / sizeof(uint64_t);
+        m_touched |= ((uint64_t(2) << last) - 1) & ~((uint64_t(1) << first) - 1);
+    }
 
     uint16_t m_order;
-    MemoryBlock *m_blocks;
+    BuddyEngine m_engine;
     char * m_buff;
 
-    std::map<MemoryBlock*, uint8_t> used;
+    std::map<char*, MappedRegion> m_mapped;     // allocations living outside the arena, keyed by the address handed out
+    uint16_t m_guardThreshold;
+    GuardPlacement m_guardPlacement;
+    uint16_t m_directThreshold;
+
     bool m_details;
+    bool m_reportLeaks;
+    bool m_measureLatency;
+    std::chrono::steady_clock::time_point m_allocStart;
+
+    Stats m_stats;                  // only ever touched by the allocating thread
+    uint64_t m_touched;             // words of m_stats changed since they were last published, see touched
+    SeqLock<Stats> m_published;     // what everybody else gets to see
 };
 
 #endif // BUDDYALLOCATOR
@@ -0,0 +1,349 @@
+#include "BuddyEngine.h"
+#include "AllocatorHooks.h"
+
+#include <algorithm>
+#include <iostream>
+
+/*
+ * The buddy system relies on the following:
+ * - blocks of size 2^k such that minOrder <= k <= order
+ * - address range from [0, 2^order - 1]
+ * - blocks are allocated by splitting larger blocks in half
+ * - blocks are reclaimed by coalescing two contiguous buddies of equal size back into the larger block it was initially split from
+ * */
+
+// bound to a reference (by std::min, EXPECT_EQ, ...) None needs a definition
+const uint64_t BuddyEngine::None;
+const uint8_t BuddyEngine::Interior;
+
+BuddyEngine::BuddyEngine(uint8_t order, uint8_t minOrder) :
+    m_order(order),
+    m_minOrder(minOrder),
+    m_units(uint64_t(1) << (order - minOrder)),
+    m_nonEmpty(0),
+    m_freeCount(),
+    m_changed(0),
+    m_splits(0),
+    m_coalesces(0),
+    m_tagWrites(nullptr),
+    m_details(false)
+{
+    // unit numbers and list heads have to fit in 32 bits, and KVAL in 7
+    if (minOrder > order || order - minOrder > 31 || order > 63) {
+        throw "Invalid order";
+    }
+
+    m_tag.resize(m_units, Interior);
+    m_linkf.resize(m_units + order + 1);
+    m_linkb.resize(m_units + order + 1);
+
+    /// \attention as in Knuth, there is a list head for every k up to order, even though the ones below minOrder are never used.
+    /// It keeps head(k) a simple addition.
+    for (int k = 0; k <= order; ++k) {
+        m_linkf[head(k)] = m_linkb[head(k)] = head(k);
+    }
+
+    // the whole range starts out as one free block
+    m_tag[0] = Available | order;
+    push(0, order);
+}
+
+uint64_t BuddyEngine::alloc(uint8_t k)
+{
+    if (k < m_minOrder) {
+        k = m_minOrder;
+    }
+
+    if (k > m_order) {
+        return None;
+    }
+
+    if (m_details) {
+        std::cout << "   Searching for free block of size " << (uint64_t(1) << k) << std::endl;
+    }
+
+    // find smallest available block that is sufficient for the request
+    uint64_t candidates = m_nonEmpty >> k;
+    if (candidates == 0) {
+        if (m_details) {
+            std::cout << "   No blocks of size >= " << (uint64_t(1) << k) << " available." << std::endl;
+        }
+        return None;
+    }
+
+    uint8_t j = k + __builtin_ctzll(candidates);
+    uint32_t unit = m_linkf[head(j)];
+    remove(unit, j);
+
+    return take(unit, j, k);
+}
+
+uint64_t BuddyEngine::allocWithin(uint8_t k, uint64_t region, uint8_t regionOrder)
+{
+    if (k < m_minOrder) {
+        k = m_minOrder;
+    }
+
+    if (k > regionOrder || regionOrder > m_order) {
+        return None;
+    }
+
+    region &= ~((uint64_t(1) << regionOrder) - 1);
+
+    // walk down to the region. If it lies within a single block there is no choice to make, all of it is either free or not
+    uint8_t j = m_order;
+    uint32_t unit;
+    while (true) {
+        unit = uint32_t((region >> j) << (j - m_minOrder));
+
+        if ((m_tag[unit] & KVal) == j) {
+            if (!(m_tag[unit] & Available)) {
+                return None;
+            }
+            return allocAt(region, k) ? region : None;
+        }
+
+        if (j == regionOrder) {
+            break;
+        }
+
+        --j;
+    }
+
+    uint32_t end = unit + (uint32_t(1) << (regionOrder - m_minOrder));
+
+    // the front of the list alloc would have used is often in the region already, and then there is nothing to look for
+    uint64_t candidates = m_nonEmpty >> k;
+    if (candidates) {
+        uint8_t smallest = k + __builtin_ctzll(candidates);
+        uint32_t front = m_linkf[head(smallest)];
+
+        if (smallest <= regionOrder && front >= unit && front < end) {
+            remove(front, smallest);
+            return take(front, smallest, k);
+        }
+    }
+
+    // the region is split up, look through its blocks for the smallest free one that is sufficient for the request
+    uint32_t best = unit;
+    uint8_t bestOrder = KVal;
+
+    for (uint32_t block = unit; block < end; block += uint32_t(1) << ((m_tag[block] & KVal) - m_minOrder)) {
+        uint8_t kval = m_tag[block] & KVal;
+
+        if ((m_tag[block] & Available) && kval >= k && kval < bestOrder) {
+            best = block;
+            bestOrder = kval;
+
+            if (kval == k) {
+                break;
+            }
+        }
+    }
+
+    if (bestOrder == KVal) {
+        return None;
+    }
+
+    remove(best, bestOrder);
+    return take(best, bestOrder, k);
+}
+
+uint64_t BuddyEngine::take(uint32_t unit, uint8_t j, uint8_t k)
+{
+    if (m_details) {
+        std::cout << "   Found available block: Block( " << (uint64_t(unit) << m_minOrder) << ", " << (uint64_t(1) << j) << " )" << std::endl;
+    }
+
+    // do we need to split blocks ?
+    while (j != k) {
+        --j;
+
+        // if so, split the block and enter the unused half in the available list
+        uint32_t buddy = buddyOf(unit, j);
+        setTag(buddy, Available | j);
+        push(buddy, j);
+        ++m_splits;
+        ALLOCATOR_HOOK(onSplit, this, uint64_t(unit) << m_minOrder, j);
+
+        if (m_details) {
+            std::cout << "      Split required - Creating smaller block: Block( " << (uint64_t(buddy) << m_minOrder) << ", " << (uint64_t(1) << j) << " )" << std::endl;
+        }
+    }
+
+    setTag(unit, k);
+    return uint64_t(unit) << m_minOrder;
+}
+
+bool BuddyEngine::allocAt(uint64_t offset, uint8_t k)
+{
+    if (k < m_minOrder || k > m_order || (offset & ((uint64_t(1) << k) - 1)) || (offset >> m_order)) {
+        return false;
+    }
+
+    // walk down from the whole range to the block containing offset. Only the starts of real blocks have meaningful tags,
+    // but whenever a block of order j is split, the start of each of its halves is one.
+    uint8_t j = m_order;
+    uint32_t unit;
+    while (true) {
+        unit = uint32_t((offset >> j) << (j - m_minOrder));
+        uint8_t kval = m_tag[unit] & KVal;
+
+        if (kval == j) {
+            break;
+        }
+
+        if (j == k) {
+            // the block we want has been split up, so some of it is in use
+            return false;
+        }
+
+        --j;
+    }
+
+    if (!(m_tag[unit] & Available)) {
+        return false;
+    }
+
+    remove(unit, j);
+
+    // split, keeping the half which holds offset and freeing the other one
+    uint32_t target = uint32_t(offset >> m_minOrder);
+    while (j != k) {
+        --j;
+
+        uint32_t lower = unit, upper = unit + (uint32_t(1) << (j - m_minOrder));
+        uint32_t spare = target >= upper ? lower : upper;
+        unit = target >= upper ? upper : lower;
+
+        setTag(spare, Available | j);
+        push(spare, j);
+        ++m_splits;
+        ALLOCATOR_HOOK(onSplit, this, uint64_t(lower) << m_minOrder, j);
+    }
+
+    setTag(unit, k);
+    return true;
+}
+
+uint8_t BuddyEngine::free(uint64_t offset)
+{
+    if ((offset >> m_order) || (offset & ((uint64_t(1) << m_minOrder) - 1))) {
+        throw "Block is out of range";
+    }
+
+    uint32_t unit = uint32_t(offset >> m_minOrder);
+
+    if ((m_tag[unit] & Available) || m_tag[unit] == Interior) {
+        throw "Block is not reserved";
+    }
+
+    uint8_t k = m_tag[unit] & KVal;
+    uint8_t released = k;
+
+    // combine buddy if:
+    // 1. we're not at the last block
+    // 2. our buddy is available
+    // 3. our buddy is also the same size we are
+    while (k != m_order) {
+        uint32_t buddy = buddyOf(unit, k);
+        if (m_tag[buddy] != (Available | k)) {
+            break;
+        }
+
+        if (m_details) {
+            std::cout << "      Coalescing - Reclaiming additional block: Block( " << (uint64_t(buddy) << m_minOrder) << ", " << (uint64_t(1) << k) << " )" << std::endl;
+        }
+
+        remove(buddy, k);
+        ++m_coalesces;
+
+        // the upper half is no block of its own any more. Left with its old tag, freeing it again would be taken at its word.
+        // Only block starts are restored, so this need not be recorded.
+        m_tag[std::max(unit, buddy)] = Interior;
+        if (buddy < unit) {
+            unit = buddy;
+        }
+        ALLOCATOR_HOOK(onCoalesce, this, uint64_t(unit) << m_minOrder, k);
+
+        // bump up block level
+        ++k;
+    }
+
+    // add newly reclaimed block to the available list
+    setTag(unit, Available | k);
+    push(unit, k);
+
+    if (m_details) {
+        std::cout << "   Free Success - New block available: Block( " << (uint64_t(unit) << m_minOrder) << ", " << (uint64_t(1) << k) << " )" << std::endl;
+    }
+
+    return released;
+}
+
+void BuddyEngine::restore(const uint8_t *tags)
+{
+    std::fill(m_tag.begin(), m_tag.end(), Interior);
+    for (int k = 0; k <= m_order; ++k) {
+        m_linkf[head(k)] = m_linkb[head(k)] = head(k);
+        m_freeCount[k] = 0;
+    }
+    m_nonEmpty = 0;
+    m_changed = (uint64_t(2) << m_order) - 1;
+
+    // every block starts with its own size, so hopping from one to the next visits the whole range
+    for (uint64_t unit = 0; unit < m_units; ) {
+        uint8_t k = tags[unit] & KVal;
+        if (k < m_minOrder || k > m_order || (unit & ((uint64_t(1) << (k - m_minOrder)) - 1))) {
+            throw "Corrupt block tags";
+        }
+
+        m_tag[unit] = tags[unit];
+        if (tags[unit] & Available) {
+            push(uint32_t(unit), k);
+        }
+
+        unit += uint64_t(1) << (k - m_minOrder);
+    }
+}
+
+int BuddyEngine::largestFree() const
+{
+    return m_nonEmpty ? 63 - __builtin_clzll(m_nonEmpty) : -1;
+}
+
+void BuddyEngine::setTag(uint32_t unit, uint8_t tag)
+{
+    m_tag[unit] = tag;
+
+    if (m_tagWrites) {
+        m_tagWrites->push_back(TagWrite{ unit, tag });
+    }
+}
+
+void BuddyEngine::push(uint32_t unit, uint8_t k)
+{
+    // new blocks go in the front of the list, which is also where alloc takes them from
+    uint32_t front = m_linkf[head(k)];
+    m_linkf[unit] = front;
+    m_linkb[unit] = head(k);
+    m_linkb[front] = unit;
+    m_linkf[head(k)] = unit;
+
+    ++m_freeCount[k];
+    m_nonEmpty |= uint64_t(1) << k;
+    m_changed |= uint64_t(1) << k;
+}
+
+void BuddyEngine::remove(uint32_t unit, uint8_t k)
+{
+    // 1. point the node behind me, to whatever is in front of me
+    // 2. point the node in front of me, to whatever is behind me
+    m_linkf[m_linkb[unit]] = m_linkf[unit];
+    m_linkb[m_linkf[unit]] = m_linkb[unit];
+
+    if (--m_freeCount[k] == 0) {
+        m_nonEmpty &= ~(uint64_t(1) << k);
+    }
+    m_changed |= uint64_t(1) << k;
+}
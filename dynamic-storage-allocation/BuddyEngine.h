@@ -0,0 +1,108 @@
+#ifndef BUDDYENGINE_H
+#define BUDDYENGINE_H
+
+#include <stdint.h>
+#include <vector>
+
+/*
+ * BuddyEngine is the buddy system on its own: it hands out aligned blocks of size 2^k from the offset range [0, 2^order)
+ * without there being any memory behind that range. The same engine can carve up an arena, a file, a device address
+ * window or a space of ids.
+ *
+ * Knuth keeps a TAG, a KVAL and the LINKF/LINKB free list pointers at the start of every block. Since we may not write to
+ * the space we manage, those fields live in arrays beside it, indexed by unit (the smallest block, 2^minOrder):
+ * - m_tag holds TAG and KVAL for the unit starting each block, and Interior for every other unit
+ * - m_linkf/m_linkb hold the free list links, with the list heads stored after the last unit
+ * */
+class BuddyEngine
+{
+public:
+    static const uint64_t None = ~uint64_t(0);
+
+    // a change to the TAG/KVAL byte of one unit, see recordTagWrites
+    struct TagWrite
+    {
+        uint32_t unit;
+        uint8_t tag;
+    };
+
+    BuddyEngine(uint8_t order, uint8_t minOrder = 0);
+
+    // offset of a block of size 2^k (at least 2^minOrder), or None if there is no room
+    uint64_t alloc(uint8_t k);
+
+    // like alloc, but only looks within the aligned 2^regionOrder block containing region
+    uint64_t allocWithin(uint8_t k, uint64_t region, uint8_t regionOrder);
+
+    // reserves the particular block [offset, offset + 2^k), false if any of it is taken
+    bool allocAt(uint64_t offset, uint8_t k);
+
+    // returns the order of the block that was released
+    uint8_t free(uint64_t offset);
+
+    uint8_t order() const { return m_order; }
+    uint8_t minOrder() const { return m_minOrder; }
+
+    // offset must be the start of a block, free or reserved
+    uint8_t orderOf(uint64_t offset) const { return m_tag[offset >> m_minOrder] & KVal; }
+    bool isFree(uint64_t offset) const { return m_tag[offset >> m_minOrder] & Available; }
+
+    uint64_t freeBlocks(uint8_t k) const { return m_freeCount[k]; }
+
+    // bit k is set if freeBlocks(k) may have changed since the last call
+    uint64_t takeChangedOrders() { uint64_t changed = m_changed; m_changed = 0; return changed; }
+    int largestFree() const;        // order of the largest free block, -1 when there is none
+    uint64_t splits() const { return m_splits; }
+    uint64_t coalesces() const { return m_coalesces; }
+
+    void showDetails(bool show) { m_details = show; }
+
+    /*
+     * The tags alone describe the whole state: the free lists can always be rebuilt from them. Someone keeping the
+     * state elsewhere (on disk, say) can have every tag change appended to writes, and later restore() from a copy.
+     * */
+    const uint8_t *tags() const { return m_tag.data(); }
+    void recordTagWrites(std::vector<TagWrite> *writes) { m_tagWrites = writes; }
+    void restore(const uint8_t *tags);
+
+    // calls visit(offset, k, available) for every block in address order
+    template <typename Visit>
+    void forEachBlock(Visit visit) const
+    {
+        for (uint64_t unit = 0; unit < m_units; unit += uint64_t(1) << ((m_tag[unit] & KVal) - m_minOrder)) {
+            visit(unit << m_minOrder, uint8_t(m_tag[unit] & KVal), bool(m_tag[unit] & Available));
+        }
+    }
+
+private:
+    static const uint8_t Available = 0x80;
+    static const uint8_t KVal = 0x7f;
+    static const uint8_t Interior = KVal;    // reserved and of no order there can be, so free() never mistakes it for a block
+
+    uint32_t head(uint8_t k) const { return uint32_t(m_units) + k; }
+    uint32_t buddyOf(uint32_t unit, uint8_t k) const { return unit ^ (uint32_t(1) << (k - m_minOrder)); }
+
+    uint64_t take(uint32_t unit, uint8_t j, uint8_t k);
+    void setTag(uint32_t unit, uint8_t tag);
+    void push(uint32_t unit, uint8_t k);
+    void remove(uint32_t unit, uint8_t k);
+
+    uint8_t m_order;
+    uint8_t m_minOrder;
+    uint64_t m_units;
+
+    std::vector<uint8_t> m_tag;
+    std::vector<uint32_t> m_linkf, m_linkb;
+
+    uint64_t m_nonEmpty;            // bit k is set while the list of free 2^k blocks has something in it
+    uint64_t m_freeCount[64];
+    uint64_t m_changed;             // see takeChangedOrders
+    uint64_t m_splits;
+    uint64_t m_coalesces;
+
+    std::vector<TagWrite> *m_tagWrites;
+
+    bool m_details;
+};
+
+#endif // BUDDYENGINE_H
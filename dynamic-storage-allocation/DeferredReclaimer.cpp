@@ -0,0 +1,122 @@
+#include "DeferredReclaimer.h"
+
+#include <algorithm>
+
+DeferredReclaimer::Local::Local(DeferredReclaimer &reclaimer) :
+    m_reclaimer(reclaimer)
+{
+    m_pending.reserve(BatchSize);
+}
+
+DeferredReclaimer::Local::~Local()
+{
+    flush();
+}
+
+void DeferredReclaimer::Local::freeDeferred(char *address)
+{
+    m_pending.push_back(address);
+
+    if (m_pending.size() == BatchSize) {
+        flush();
+    }
+}
+
+void DeferredReclaimer::Local::flush()
+{
+    if (!m_pending.empty()) {
+        m_reclaimer.handOff(m_pending);
+        m_pending.reserve(BatchSize);
+    }
+}
+
+DeferredReclaimer::DeferredReclaimer(LockedAllocator &allocator, size_t maxOutstanding) :
+    m_allocator(allocator),
+    m_maxOutstanding(maxOutstanding),
+    m_outstanding(0),
+    m_stalls(0),
+    m_running(true)
+{
+    m_thread = std::thread(&DeferredReclaimer::run, this);
+}
+
+DeferredReclaimer::~DeferredReclaimer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_work.notify_all();
+
+    m_thread.join();
+}
+
+void DeferredReclaimer::handOff(std::vector<char*> &addresses)
+{
+    Batch batch;
+    batch.bytes = m_allocator.blockSizes(addresses.data(), addresses.size());
+    batch.addresses.swap(addresses);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // a batch bigger than the bound on its own still has to go through at some point, so it only waits for an empty queue
+    auto room = [&] { return m_outstanding == 0 || m_outstanding + batch.bytes <= m_maxOutstanding; };
+    if (!room()) {
+        ++m_stalls;
+        m_room.wait(lock, room);
+    }
+
+    m_outstanding += batch.bytes;
+    m_batches.push_back(std::move(batch));
+    m_work.notify_one();
+}
+
+void DeferredReclaimer::drain()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_room.wait(lock, [&] { return m_outstanding == 0; });
+}
+
+size_t DeferredReclaimer::outstanding()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_outstanding;
+}
+
+uint64_t DeferredReclaimer::stalls()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stalls;
+}
+
+void DeferredReclaimer::run()
+{
+    std::vector<char*> addresses;
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        m_work.wait(lock, [&] { return !m_batches.empty() || !m_running; });
+
+        if (m_batches.empty()) {
+            break;
+        }
+
+        // take everything queued up, so a backlog is worked off in fewer, larger sorted runs
+        size_t bytes = 0;
+        addresses.clear();
+        for (auto && batch : m_batches) {
+            addresses.insert(addresses.end(), batch.addresses.begin(), batch.addresses.end());
+            bytes += batch.bytes;
+        }
+        m_batches.clear();
+
+        lock.unlock();
+
+        std::sort(addresses.begin(), addresses.end());
+        m_allocator.freeBatch(addresses.data(), addresses.size());
+
+        lock.lock();
+        m_outstanding -= bytes;
+        m_room.notify_all();
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef DEFERREDRECLAIMER_H
+#define DEFERREDRECLAIMER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "LockedAllocator.h"
+
+/*
+ * DeferredReclaimer takes frees off latency critical threads. Tearing down a large structure is thousands of frees, each
+ * of which may coalesce its way up the heap; with a reclaimer the thread just drops the pointers into a buffer of its
+ * own, and a background thread does the actual freeing.
+ *
+ * Every thread deferring frees keeps a Local. Once it has collected BatchSize pointers they are handed off as a batch,
+ * and the reclaimer frees batches sorted by address, so buddies are released next to each other and merge right away.
+ * The bytes handed off but not yet freed are bounded: a hand-off that would go over the bound waits until the reclaimer
+ * has caught up, which keeps a thread that frees faster than it can be reclaimed from eating the heap.
+ *
+ *     DeferredReclaimer::Local local(reclaimer);
+ *     for (Node *node : tree) {
+ *         local.freeDeferred((char*)node);
+ *     }
+ * */
+class DeferredReclaimer
+{
+public:
+    static const size_t BatchSize = 256;
+
+    class Local
+    {
+    public:
+        explicit Local(DeferredReclaimer &reclaimer);
+        ~Local();
+
+        void freeDeferred(char *address);
+
+        // hands off whatever has been collected so far
+        void flush();
+
+    private:
+        DeferredReclaimer &m_reclaimer;
+        std::vector<char*> m_pending;
+    };
+
+    DeferredReclaimer(LockedAllocator &allocator, size_t maxOutstanding);
+
+    // frees everything still outstanding first
+    ~DeferredReclaimer();
+
+    // waits until everything handed off so far has been freed
+    void drain();
+
+    size_t outstanding();
+    uint64_t stalls();              // hand-offs that had to wait for the bound
+
+private:
+    struct Batch
+    {
+        std::vector<char*> addresses;
+        size_t bytes;
+    };
+
+    void handOff(std::vector<char*> &addresses);
+    void run();
+
+    LockedAllocator &m_allocator;
+    size_t m_maxOutstanding;
+
+    std::mutex m_mutex;
+    std::condition_variable m_work;     // a batch came in, or it is time to stop
+    std::condition_variable m_room;     // a batch has been freed
+
+    std::deque<Batch> m_batches;
+    size_t m_outstanding;
+    uint64_t m_stalls;
+    bool m_running;
+
+    std::thread m_thread;
+};
+
+#endif // DEFERREDRECLAIMER_H
@@ -1,11 +1,59 @@
 TEMPLATE = app
-CONFIG += console c++14
+CONFIG += console c++14 thread
 CONFIG -= app_bundle
 CONFIG -= qt
 
+# annotate the arena for Valgrind's Memcheck (ASan builds are annotated automatically)
+# DEFINES += BUDDY_VALGRIND
+
+# compile out the allocator event hooks, see AllocatorHooks.h
+# DEFINES += BUDDY_NO_HOOKS
+
 SOURCES += main.cpp \
-    BuddyAllocator.cpp
+    AllocationScope.cpp \
+    AllocatorHooks.cpp \
+    BuddyAllocator.cpp \
+    BuddyEngine.cpp \
+    DeferredReclaimer.cpp \
+    EmergencyReserve.cpp \
+    EpochReclaimer.cpp \
+    ExtentAllocator.cpp \
+    LifetimeAllocator.cpp \
+    LineAllocator.cpp \
+    LockedAllocator.cpp \
+    MappedRegion.cpp \
+    MicroAllocator.cpp \
+    MobilityAllocator.cpp \
+    PerCpuCache.cpp \
+    PersistentHeap.cpp \
+    ProfiledMutex.cpp \
+    PrometheusExporter.cpp \
+    QuaternaryEngine.cpp \
+    SubtreeLockedAllocator.cpp \
+    WaitingAllocator.cpp
 
 HEADERS += \
+    AllocationScope.h \
     Allocator.h \
-    BuddyAllocator.h
+    AllocatorHooks.h \
+    BuddyAllocator.h \
+    BuddyEngine.h \
+    DeferredReclaimer.h \
+    EmergencyReserve.h \
+    EpochReclaimer.h \
+    ExtentAllocator.h \
+    LifetimeAllocator.h \
+    LineAllocator.h \
+    LockedAllocator.h \
+    MappedRegion.h \
+    MemoryPoisoning.h \
+    MicroAllocator.h \
+    MobilityAllocator.h \
+    PerCpuCache.h \
+    PersistentHeap.h \
+    ProfiledMutex.h \
+    PrometheusExporter.h \
+    QuaternaryEngine.h \
+    SeqLock.h \
+    SubtreeLockedAllocator.h \
+    WaitingAllocator.h
@@ -0,0 +1,121 @@
+#include "EmergencyReserve.h"
+
+#include <algorithm>
+#include <iostream>
+
+EmergencyReserve::EmergencyReserve(BuddyAllocator &allocator) :
+    m_allocator(allocator),
+    m_target(),
+    m_deficit(0),
+    m_smallestMissing(BuddyAllocator::MaxOrder + 1),
+    m_counters()
+{
+}
+
+EmergencyReserve::~EmergencyReserve()
+{
+    for (auto && blocks : m_reserve) {
+        for (char *block : blocks) {
+            m_allocator.free(block);
+        }
+    }
+}
+
+void EmergencyReserve::reserve(uint8_t k, uint16_t count)
+{
+    // such a block could never be had, and the reserve would try for it on every free
+    if (k > m_allocator.order()) {
+        throw "Insufficient Memory";
+    }
+
+    // shrinking hands the surplus straight back
+    while (m_reserve[k].size() > count) {
+        m_allocator.free(m_reserve[k].back());
+        m_reserve[k].pop_back();
+    }
+
+    m_target[k] = count;
+    findMissing();
+    refill();
+}
+
+char *EmergencyReserve::alloc(uint16_t bytes)
+{
+    return m_allocator.alloc(bytes);
+}
+
+char *EmergencyReserve::allocCritical(uint16_t bytes)
+{
+    if (char *address = m_allocator.tryAlloc(bytes)) {
+        return address;
+    }
+
+    // smallest reserved block that will do
+    for (int k = BuddyAllocator::orderFor(bytes); k <= BuddyAllocator::MaxOrder; ++k) {
+        if (!m_reserve[k].empty()) {
+            char *address = m_reserve[k].back();
+            m_reserve[k].pop_back();
+            ++m_deficit;
+            m_smallestMissing = std::min(m_smallestMissing, k);
+            ++m_counters.reserveHits;
+            return address;
+        }
+    }
+
+    ++m_counters.exhausted;
+    throw "Insufficient Memory!";
+}
+
+void EmergencyReserve::free(char *address)
+{
+    m_allocator.free(address);
+
+    // while the heap is exhausted most frees don't make room for anything the reserve misses, those cost just this check
+    if (m_deficit && m_allocator.largestFree() >= m_smallestMissing) {
+        refill();
+    }
+}
+
+void EmergencyReserve::refill()
+{
+    // largest first, they are the hardest to come by. Only ask for what is known to fit, so no failure ever gets counted
+    for (int k = BuddyAllocator::MaxOrder; k >= m_smallestMissing; --k) {
+        while (m_reserve[k].size() < m_target[k] && m_allocator.largestFree() >= k) {
+            char *block = m_allocator.tryAlloc(uint16_t(std::min(1u << k, 0xffffu)));
+            if (!block) {
+                break;
+            }
+
+            m_reserve[k].push_back(block);
+            ++m_counters.refills;
+        }
+    }
+
+    findMissing();
+}
+
+void EmergencyReserve::findMissing()
+{
+    m_deficit = 0;
+    m_smallestMissing = BuddyAllocator::MaxOrder + 1;
+
+    for (int k = BuddyAllocator::MaxOrder; k >= 0; --k) {
+        if (m_reserve[k].size() < m_target[k]) {
+            m_deficit += m_target[k] - m_reserve[k].size();
+            m_smallestMissing = k;
+        }
+    }
+}
+
+void EmergencyReserve::print()
+{
+    m_allocator.print();
+
+    std::cout << "========= Emergency Reserve =======" << std::endl << std::endl;
+    for (int k = 0; k <= BuddyAllocator::MaxOrder; ++k) {
+        if (m_target[k]) {
+            std::cout << "{ " << (1u << k) << " bytes: " << m_reserve[k].size() << " of " << m_target[k] << " }" << std::endl;
+        }
+    }
+    std::cout << "hits " << m_counters.reserveHits << ", refills " << m_counters.refills << ", exhausted " << m_counters.exhausted << std::endl << std::endl;
+}
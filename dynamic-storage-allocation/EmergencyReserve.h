@@ -0,0 +1,53 @@
+#ifndef EMERGENCYRESERVE_H
+#define EMERGENCYRESERVE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "Allocator.h"
+#include "BuddyAllocator.h"
+
+/*
+ * EmergencyReserve sets blocks aside so that critical allocations (error handling, shutdown) still succeed once bulk
+ * traffic has exhausted the heap. Bulk allocations never touch the reserve; critical ones use the heap like everybody
+ * else and only draw on the reserve when the heap comes up empty. Every free tops the reserve back up first.
+ * */
+class EmergencyReserve : public Allocator
+{
+public:
+    struct Counters
+    {
+        uint64_t reserveHits;       // critical allocations served from the reserve
+        uint64_t refills;           // blocks put back into the reserve
+        uint64_t exhausted;         // critical allocations that failed even with the reserve
+    };
+
+    explicit EmergencyReserve(BuddyAllocator &allocator);
+    ~EmergencyReserve();
+
+    // keep count blocks of size 2^k on hand, taking them from the heap as soon as it can spare them. k may not exceed the arena
+    void reserve(uint8_t k, uint16_t count);
+
+    char *alloc(uint16_t bytes) override;
+    char *allocCritical(uint16_t bytes);
+    void free(char *address) override;
+    void print() override;
+
+    size_t available(uint8_t k) const { return m_reserve[k].size(); }
+    const Counters &counters() const { return m_counters; }
+
+private:
+    void refill();
+    void findMissing();
+
+    BuddyAllocator &m_allocator;
+
+    std::vector<char*> m_reserve[BuddyAllocator::MaxOrder + 1];
+    uint16_t m_target[BuddyAllocator::MaxOrder + 1];
+    size_t m_deficit;               // blocks missing across all orders, so a full reserve costs free nothing
+    int m_smallestMissing;          // lowest order short of its target, a free that leaves no block this large can't help
+
+    Counters m_counters;
+};
+
+#endif // EMERGENCYRESERVE_H
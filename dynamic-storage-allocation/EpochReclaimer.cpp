@@ -0,0 +1,147 @@
+#include "EpochReclaimer.h"
+
+#include <algorithm>
+
+namespace
+{
+    /*
+     * Nodes retired while the global epoch was e are safe once it reaches e + 2. Whoever could have found a node before
+     * it was unlinked was pinned in e at the latest, and the epoch only moves from e + 1 to e + 2 once nobody is pinned
+     * in e any more.
+     * */
+    bool reclaimable(uint64_t retired, uint64_t epoch)
+    {
+        return retired + 2 <= epoch;
+    }
+}
+
+EpochReclaimer::Participant::Participant(EpochReclaimer &reclaimer) :
+    m_reclaimer(reclaimer),
+    m_announced(0),
+    m_epoch(0),
+    m_limboEpoch(),
+    m_retired(0)
+{
+    std::lock_guard<std::mutex> lock(m_reclaimer.m_mutex);
+    m_reclaimer.m_participants.push_back(this);
+}
+
+EpochReclaimer::Participant::~Participant()
+{
+    std::lock_guard<std::mutex> lock(m_reclaimer.m_mutex);
+
+    auto &participants = m_reclaimer.m_participants;
+    participants.erase(std::find(participants.begin(), participants.end(), this));
+
+    for (int i = 0; i < 3; ++i) {
+        if (!m_limbo[i].empty()) {
+            m_reclaimer.m_orphans.emplace_back(m_limboEpoch[i], std::move(m_limbo[i]));
+        }
+    }
+}
+
+void EpochReclaimer::Participant::pin()
+{
+    // not being pinned ourselves we cannot hold the epoch back, so this is the moment to try moving it along
+    if (m_retired >= BatchSize && m_reclaimer.tryAdvance()) {
+        m_retired = 0;
+    }
+
+    // announce, then make sure the epoch did not move on before anyone could see the announcement
+    uint64_t epoch = m_reclaimer.m_epoch.load();
+    while (true) {
+        m_announced.store(epoch << 1 | 1);
+
+        uint64_t current = m_reclaimer.m_epoch.load();
+        if (current == epoch) {
+            break;
+        }
+        epoch = current;
+    }
+
+    m_epoch = epoch;
+    collect();
+}
+
+void EpochReclaimer::Participant::unpin()
+{
+    m_announced.store(0);
+}
+
+void EpochReclaimer::Participant::retire(char *address)
+{
+    // tagged with the global epoch, not the one we are pinned in. The epoch may have moved on by one since we pinned,
+    // and a thread pinned in that newer epoch may have found the node before it was unlinked
+    uint64_t epoch = m_reclaimer.m_epoch.load();
+
+    // the list for that epoch may still hold what was retired three epochs ago, which is safe by now
+    std::vector<char*> &limbo = m_limbo[epoch % 3];
+    if (!limbo.empty() && m_limboEpoch[epoch % 3] != epoch) {
+        m_reclaimer.release(limbo);
+    }
+
+    limbo.push_back(address);
+    m_limboEpoch[epoch % 3] = epoch;
+    ++m_retired;
+}
+
+void EpochReclaimer::Participant::collect()
+{
+    for (int i = 0; i < 3; ++i) {
+        if (!m_limbo[i].empty() && reclaimable(m_limboEpoch[i], m_epoch)) {
+            m_reclaimer.release(m_limbo[i]);
+        }
+    }
+}
+
+EpochReclaimer::EpochReclaimer(LockedAllocator &allocator) :
+    m_allocator(allocator),
+    m_epoch(2),                 // so that epoch + 2 never has to be compared against anything below zero
+    m_reclaimed(0)
+{
+}
+
+EpochReclaimer::~EpochReclaimer()
+{
+    for (auto && orphan : m_orphans) {
+        release(orphan.second);
+    }
+}
+
+bool EpochReclaimer::tryAdvance()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint64_t epoch = m_epoch.load();
+    for (Participant *participant : m_participants) {
+        uint64_t announced = participant->m_announced.load();
+        if ((announced & 1) && (announced >> 1) != epoch) {
+            return false;
+        }
+    }
+
+    if (!m_epoch.compare_exchange_strong(epoch, epoch + 1)) {
+        return false;
+    }
+
+    // whatever was left behind is reclaimed by whoever moves the epoch along
+    auto safe = std::partition(m_orphans.begin(), m_orphans.end(), [&](const std::pair<uint64_t, std::vector<char*>> &orphan) {
+        return !reclaimable(orphan.first, epoch + 1);
+    });
+    for (auto orphan = safe; orphan != m_orphans.end(); ++orphan) {
+        release(orphan->second);
+    }
+    m_orphans.erase(safe, m_orphans.end());
+
+    return true;
+}
+
+void EpochReclaimer::release(std::vector<char*> &addresses)
+{
+    // in address order, so buddies go back next to each other
+    std::sort(addresses.begin(), addresses.end());
+    m_allocator.freeBatch(addresses.data(), addresses.size());
+
+    m_reclaimed += addresses.size();
+    addresses.clear();
+}
@@ -0,0 +1,100 @@
+#ifndef EPOCHRECLAIMER_H
+#define EPOCHRECLAIMER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "LockedAllocator.h"
+
+/*
+ * EpochReclaimer is epoch based reclamation for lock free structures built on the buddy heap. A node unlinked from such a
+ * structure may still be read by a thread that found it a moment earlier, so instead of being freed it is retired, and
+ * only goes back to the heap once no thread can still be looking at it.
+ *
+ * There is a global epoch, and every thread taking part announces the epoch it saw whenever it is pinned (inside a
+ * Guard, around its accesses to the structure). The epoch only advances once every pinned thread has seen the current
+ * one, so a node retired while the global epoch was e is unreachable for everybody once the epoch reaches e + 2. Note
+ * that e is read at retirement: it can be one ahead of the epoch the retiring thread is pinned in, and tagging with the
+ * older one would free the node under a thread that pinned in between. Each thread keeps its retired nodes in three limbo
+ * lists, one per epoch still in play, and frees a list in one sorted batch as soon as the epoch it was filled in is old
+ * enough; advancing the epoch is left to whoever has retired enough to care.
+ *
+ *     EpochReclaimer::Participant self(reclaimer);      // one per thread
+ *     {
+ *         EpochReclaimer::Guard guard(self);
+ *         Node *node = stack.pop();
+ *         self.retire((char*)node);
+ *     }
+ * */
+class EpochReclaimer
+{
+public:
+    // retirements before a participant starts trying to advance the epoch, on every pin until it succeeds
+    static const size_t BatchSize = 128;
+
+    class Participant
+    {
+    public:
+        explicit Participant(EpochReclaimer &reclaimer);
+
+        // must not be pinned. Nodes still in limbo are left with the reclaimer
+        ~Participant();
+
+        void pin();
+        void unpin();
+
+        // only while pinned, and once the node can no longer be found
+        void retire(char *address);
+
+    private:
+        friend class EpochReclaimer;
+
+        void collect();
+
+        EpochReclaimer &m_reclaimer;
+
+        std::atomic<uint64_t> m_announced;  // epoch << 1 | 1 while pinned, 0 otherwise
+        uint64_t m_epoch;                   // the epoch we are pinned in
+
+        std::vector<char*> m_limbo[3];      // indexed by the global epoch at retirement % 3
+        uint64_t m_limboEpoch[3];
+        size_t m_retired;                   // since we last advanced the epoch
+    };
+
+    class Guard
+    {
+    public:
+        explicit Guard(Participant &participant) : m_participant(participant) { m_participant.pin(); }
+        ~Guard() { m_participant.unpin(); }
+
+    private:
+        Participant &m_participant;
+    };
+
+    explicit EpochReclaimer(LockedAllocator &allocator);
+
+    // every participant has to be gone by now
+    ~EpochReclaimer();
+
+    uint64_t epoch() const { return m_epoch.load(); }
+    uint64_t reclaimed() const { return m_reclaimed.load(); }
+
+private:
+    bool tryAdvance();
+    void release(std::vector<char*> &addresses);
+
+    LockedAllocator &m_allocator;
+
+    std::atomic<uint64_t> m_epoch;
+    std::atomic<uint64_t> m_reclaimed;
+
+    std::mutex m_mutex;                                             // guards the two below
+    std::vector<Participant*> m_participants;
+    std::vector<std::pair<uint64_t, std::vector<char*>>> m_orphans; // limbo lists left behind, with their epochs
+};
+
+#endif // EPOCHRECLAIMER_H
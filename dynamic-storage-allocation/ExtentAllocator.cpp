@@ -0,0 +1,296 @@
+#include "ExtentAllocator.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    const uint32_t Magic = 0x42554459;      // "BUDY"
+
+    const uint8_t Alloc = 1;
+    const uint8_t Free = 2;
+
+    // records queued before alloc/free sync on their own
+    const size_t BatchRecords = 256;
+
+    // journal records before sync folds them into a new checkpoint
+    const uint64_t CheckpointRecords = 1 << 16;
+
+    struct Checkpoint
+    {
+        uint32_t magic;
+        uint8_t order;
+        uint8_t minOrder;
+        uint16_t unused;
+        uint64_t sequence;          // last journal record included
+    };
+
+    uint32_t fnv1a(const void *data, size_t bytes)
+    {
+        const uint8_t *p = (const uint8_t*) data;
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < bytes; ++i) {
+            hash = (hash ^ p[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    void writeAll(int fd, const void *data, size_t bytes)
+    {
+        const char *p = (const char*) data;
+        while (bytes) {
+            ssize_t written = ::write(fd, p, bytes);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw "Unable to write extent metadata";
+            }
+            p += written;
+            bytes -= written;
+        }
+    }
+
+    // the bitmap of order k starts after the header and the bitmaps of every order below it
+    size_t bitmapBytes(uint8_t order, uint8_t k)
+    {
+        return ((uint64_t(1) << (order - k)) + 7) / 8;
+    }
+
+    void syncDirectory(const std::string &path)
+    {
+        std::string directory = ".";
+        size_t slash = path.rfind('/');
+        if (slash != std::string::npos) {
+            directory = path.substr(0, slash + 1);
+        }
+
+        int fd = open(directory.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            fsync(fd);
+            close(fd);
+        }
+    }
+}
+
+ExtentAllocator::ExtentAllocator(const std::string &path, uint8_t order, uint8_t minOrder) :
+    m_path(path),
+    m_engine(order, minOrder),
+    m_journal(-1),
+    m_sequence(0),
+    m_journalRecords(0)
+{
+    struct stat info;
+    bool existing = stat((m_path + ".bitmap").c_str(), &info) == 0;
+
+    m_journal = open((m_path + ".journal").c_str(), O_RDWR | O_CREAT, 0644);
+    if (m_journal < 0) {
+        throw "Unable to open extent journal";
+    }
+
+    if (existing) {
+        load();
+        replay();
+    } else {
+        checkpoint();
+    }
+}
+
+ExtentAllocator::~ExtentAllocator()
+{
+    try {
+        sync();
+    } catch (const char *) {
+        // whatever didn't make it is lost, exactly as if we had crashed
+    }
+    close(m_journal);
+}
+
+uint64_t ExtentAllocator::alloc(uint64_t bytes)
+{
+    uint8_t k = m_engine.minOrder();
+    while (k < 64 && (uint64_t(1) << k) < bytes) {
+        ++k;
+    }
+
+    uint64_t offset = m_engine.alloc(k);
+    if (offset == BuddyEngine::None) {
+        throw "Insufficient Space";
+    }
+
+    append(Alloc, offset, k);
+    return offset;
+}
+
+void ExtentAllocator::free(uint64_t offset)
+{
+    uint8_t k = m_engine.free(offset);
+    append(Free, offset, k);
+}
+
+void ExtentAllocator::append(uint8_t op, uint64_t offset, uint8_t k)
+{
+    Record record = {};
+    record.sequence = ++m_sequence;
+    record.offset = offset;
+    record.op = op;
+    record.k = k;
+    record.checksum = fnv1a(&record, offsetof(Record, checksum));
+
+    m_pending.push_back(record);
+
+    if (m_pending.size() >= BatchRecords) {
+        sync();
+    }
+}
+
+void ExtentAllocator::sync()
+{
+    if (m_pending.empty()) {
+        return;
+    }
+
+    writeAll(m_journal, m_pending.data(), m_pending.size() * sizeof(Record));
+    if (fdatasync(m_journal) != 0) {
+        throw "Unable to write extent metadata";
+    }
+
+    m_journalRecords += m_pending.size();
+    m_pending.clear();
+
+    if (m_journalRecords >= CheckpointRecords) {
+        checkpoint();
+    }
+}
+
+void ExtentAllocator::checkpoint()
+{
+    // whatever is queued goes straight into the checkpoint instead of the journal
+    m_pending.clear();
+
+    Checkpoint header = {};
+    header.magic = Magic;
+    header.order = m_engine.order();
+    header.minOrder = m_engine.minOrder();
+    header.sequence = m_sequence;
+
+    std::vector<std::vector<uint8_t>> bitmaps(m_engine.order() + 1);
+    for (uint8_t k = m_engine.minOrder(); k <= m_engine.order(); ++k) {
+        bitmaps[k].resize(bitmapBytes(m_engine.order(), k));
+    }
+
+    m_engine.forEachBlock([&](uint64_t offset, uint8_t k, bool available) {
+        if (!available) {
+            uint64_t index = offset >> k;
+            bitmaps[k][index / 8] |= 1 << (index % 8);
+        }
+    });
+
+    // write the new checkpoint beside the old one, then swap it in
+    std::string temporary = m_path + ".bitmap.tmp";
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw "Unable to write extent checkpoint";
+    }
+
+    try {
+        writeAll(fd, &header, sizeof(header));
+        for (uint8_t k = m_engine.minOrder(); k <= m_engine.order(); ++k) {
+            writeAll(fd, bitmaps[k].data(), bitmaps[k].size());
+        }
+    } catch (const char *) {
+        close(fd);
+        throw;
+    }
+
+    if (fsync(fd) != 0 || close(fd) != 0 || rename(temporary.c_str(), (m_path + ".bitmap").c_str()) != 0) {
+        throw "Unable to write extent checkpoint";
+    }
+    syncDirectory(m_path);
+
+    // the journal is only needed past this point, and replay skips anything older than the checkpoint anyway
+    if (ftruncate(m_journal, 0) != 0 || lseek(m_journal, 0, SEEK_SET) != 0 || fsync(m_journal) != 0) {
+        throw "Unable to write extent metadata";
+    }
+    m_journalRecords = 0;
+}
+
+void ExtentAllocator::load()
+{
+    int fd = open((m_path + ".bitmap").c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw "Unable to read extent checkpoint";
+    }
+
+    Checkpoint header;
+    std::vector<uint8_t> bitmap;
+    bool valid = pread(fd, &header, sizeof(header), 0) == sizeof(header) && header.magic == Magic
+            && header.order == m_engine.order() && header.minOrder == m_engine.minOrder();
+
+    off_t position = sizeof(header);
+    for (uint8_t k = m_engine.minOrder(); valid && k <= m_engine.order(); ++k) {
+        bitmap.resize(bitmapBytes(m_engine.order(), k));
+        valid = pread(fd, bitmap.data(), bitmap.size(), position) == ssize_t(bitmap.size());
+        position += bitmap.size();
+
+        for (size_t byte = 0; valid && byte < bitmap.size(); ++byte) {
+            for (uint8_t bit = 0; valid && bitmap[byte] >> bit; ++bit) {
+                if (bitmap[byte] & (1 << bit)) {
+                    valid = m_engine.allocAt((uint64_t(byte) * 8 + bit) << k, k);
+                }
+            }
+        }
+    }
+
+    close(fd);
+
+    if (!valid) {
+        throw "Corrupt extent checkpoint";
+    }
+
+    m_sequence = header.sequence;
+}
+
+void ExtentAllocator::replay()
+{
+    Record record;
+    off_t position = 0;
+
+    while (pread(m_journal, &record, sizeof(record), position) == sizeof(record)) {
+        if (record.checksum != fnv1a(&record, offsetof(Record, checksum))) {
+            break;
+        }
+
+        if (record.sequence <= m_sequence) {
+            // already part of the checkpoint, we crashed before the journal was truncated
+            position += sizeof(record);
+            continue;
+        }
+
+        if (record.sequence != m_sequence + 1) {
+            break;
+        }
+
+        if (record.op == Alloc) {
+            if (!m_engine.allocAt(record.offset, record.k)) {
+                throw "Corrupt extent journal";
+            }
+        } else {
+            m_engine.free(record.offset);
+        }
+
+        m_sequence = record.sequence;
+        position += sizeof(record);
+        ++m_journalRecords;
+    }
+
+    // anything after the last good record is a torn write, get rid of it before appending
+    if (ftruncate(m_journal, position) != 0 || lseek(m_journal, position, SEEK_SET) != position) {
+        throw "Unable to write extent metadata";
+    }
+}
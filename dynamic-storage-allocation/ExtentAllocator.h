@@ -0,0 +1,61 @@
+#ifndef EXTENTALLOCATOR_H
+#define EXTENTALLOCATOR_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "BuddyEngine.h"
+
+/*
+ * ExtentAllocator hands out extents of a file's offset space using the buddy system, and keeps track of them on disk so
+ * they survive a crash. The file itself is never touched, only two files beside it:
+ *
+ * - <path>.bitmap is a checkpoint: for every order k a bitmap of which 2^k extents were reserved, plus the sequence
+ *   number of the last journal record it includes. It is only ever replaced whole, by renaming a new copy over it.
+ * - <path>.journal is a write-ahead log of every alloc and free since that checkpoint.
+ *
+ * alloc and free only queue a journal record. sync() writes everything queued with a single write and fdatasync, so an
+ * extent is durable once sync() returns, and callers should not hand out an extent's contents before then. On startup
+ * the checkpoint is loaded and the journal replayed on top of it; a torn record at the end of the journal is dropped.
+ * */
+class ExtentAllocator
+{
+public:
+    // manages [0, 2^order) in extents of at least 2^minOrder bytes, recovering any state already at path
+    ExtentAllocator(const std::string &path, uint8_t order, uint8_t minOrder);
+    ~ExtentAllocator();
+
+    uint64_t alloc(uint64_t bytes);
+    void free(uint64_t offset);
+
+    void sync();
+    void checkpoint();
+
+    const BuddyEngine &engine() const { return m_engine; }
+
+private:
+    struct Record
+    {
+        uint64_t sequence;
+        uint64_t offset;
+        uint8_t op;
+        uint8_t k;
+        uint16_t unused;
+        uint32_t checksum;          // of everything above, tells a torn write from a real record
+    };
+
+    void load();
+    void replay();
+    void append(uint8_t op, uint64_t offset, uint8_t k);
+
+    std::string m_path;
+    BuddyEngine m_engine;
+
+    int m_journal;
+    std::vector<Record> m_pending;
+    uint64_t m_sequence;            // of the last record queued
+    uint64_t m_journalRecords;      // records in the journal file, checkpoints once there are too many
+};
+
+#endif // EXTENTALLOCATOR_H
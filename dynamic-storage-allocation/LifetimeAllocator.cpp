@@ -0,0 +1,127 @@
+#include "LifetimeAllocator.h"
+
+#include <iostream>
+
+namespace
+{
+    // the arena's smallest block, the granularity of the birth and site records
+    const uint8_t UnitOrder = 3;
+
+    // once a site has seen this many frees its counts are halved, so old behaviour fades out
+    const uint32_t SiteHistory = 256;
+
+    // long-lived blocks are packed into regions of this order, twice the size of the largest ones in the traces we
+    // measured. Larger regions let them spread out into the short-lived traffic again
+    const uint8_t RegionOrder = 8;
+}
+
+LifetimeAllocator::LifetimeAllocator(BuddyAllocator &allocator, uint32_t longLived) :
+    m_allocator(allocator),
+    m_longLived(longLived),
+    m_clock(0),
+    m_region(nullptr),
+    m_birth(allocator.capacity() >> UnitOrder),
+    m_site(allocator.capacity() >> UnitOrder),
+    m_counters()
+{
+}
+
+char *LifetimeAllocator::alloc(uint16_t bytes)
+{
+    return allocFrom(bytes, uintptr_t(__builtin_return_address(0)), Lifetime::Unknown);
+}
+
+char *LifetimeAllocator::alloc(uint16_t bytes, Lifetime hint)
+{
+    return allocFrom(bytes, uintptr_t(__builtin_return_address(0)), hint);
+}
+
+char *LifetimeAllocator::allocFrom(uint16_t bytes, uintptr_t site, Lifetime hint)
+{
+    Lifetime lifetime = hint == Lifetime::Unknown ? predict(site) : hint;
+    uint8_t regionOrder = m_allocator.order() < RegionOrder ? m_allocator.order() : RegionOrder;
+
+    char *address = nullptr;
+    if (lifetime == Lifetime::Long && m_region) {
+        address = m_allocator.tryAllocNear(bytes, m_region, regionOrder);
+    }
+    if (!address) {
+        address = m_allocator.alloc(bytes);
+
+        // a block as large as a region is a region of its own, there is nothing to pack next to it
+        if (lifetime == Lifetime::Long && m_allocator.inArena(address) && BuddyAllocator::orderFor(bytes) < regionOrder) {
+            m_region = address;
+            ++m_counters.regions;
+        }
+    }
+    ++m_clock;
+
+    if (lifetime == Lifetime::Long) {
+        ++m_counters.longAllocs;
+        m_counters.predictedLong += hint == Lifetime::Unknown;
+    } else {
+        ++m_counters.shortAllocs;
+    }
+
+    if (!m_allocator.inArena(address)) {
+        // mapped, there is no arena to keep tidy
+        return address;
+    }
+
+    uint64_t offset = uint64_t(address - m_allocator.base());
+    m_birth[offset >> UnitOrder] = m_clock;
+    m_site[offset >> UnitOrder] = site;
+    return address;
+}
+
+LifetimeAllocator::Lifetime LifetimeAllocator::predict(uintptr_t site) const
+{
+    auto found = m_sites.find(site);
+    if (found == m_sites.end() || found->second.longLived <= found->second.shortLived) {
+        return Lifetime::Short;
+    }
+    return Lifetime::Long;
+}
+
+void LifetimeAllocator::free(char *address)
+{
+    if (m_allocator.inArena(address)) {
+        uint64_t offset = uint64_t(address - m_allocator.base());
+        Site &site = m_sites[m_site[offset >> UnitOrder]];
+
+        if (m_clock - m_birth[offset >> UnitOrder] >= m_longLived) {
+            ++site.longLived;
+        } else {
+            ++site.shortLived;
+        }
+
+        if (site.longLived + site.shortLived >= SiteHistory) {
+            site.longLived /= 2;
+            site.shortLived /= 2;
+        }
+    }
+
+    m_allocator.free(address);
+}
+
+void LifetimeAllocator::print()
+{
+    m_allocator.print();
+
+    std::cout << "========= Lifetimes =======" << std::endl << std::endl;
+    std::cout << "short " << m_counters.shortAllocs << ", long " << m_counters.longAllocs
+              << " (" << m_counters.predictedLong << " predicted), regions " << m_counters.regions << std::endl;
+    std::cout << m_sites.size() << " call site(s), fragmentation " << fragmentation() << std::endl << std::endl;
+}
+
+double LifetimeAllocator::fragmentation() const
+{
+    BuddyAllocator::Stats stats = m_allocator.stats();
+
+    uint64_t freeBytes = 0;
+    for (int k = 0; k <= BuddyAllocator::MaxOrder; ++k) {
+        freeBytes += uint64_t(stats.freeBlocks[k]) << k;
+    }
+
+    return freeBytes ? 1.0 - double(stats.largestFree) / freeBytes : 0.0;
+}
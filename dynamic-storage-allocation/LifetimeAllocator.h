@@ -0,0 +1,77 @@
+#ifndef LIFETIMEALLOCATOR_H
+#define LIFETIMEALLOCATOR_H
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "Allocator.h"
+#include "BuddyAllocator.h"
+
+/*
+ * LifetimeAllocator keeps long-lived blocks away from short-lived ones. A long-lived block sitting in the middle of
+ * short-lived traffic pins its buddy, and everything above it, so the heap never coalesces back into large blocks.
+ *
+ * Short-lived allocations go to the heap as they are. Long-lived ones are packed together in small regions of 256
+ * bytes: each goes into the region the previous one went to, and only when that is full does the heap pick a place for
+ * it, which becomes the region for the ones after it. The heap keeps choosing where, best fit as ever, so no large block
+ * is broken up for nothing; and a region is small enough that looking through it costs no more than a few tags. Which
+ * class an allocation belongs to is either given by the caller or predicted from its call site: every free tells us how
+ * long the block lived (counted in allocations made in the meantime), and a site whose blocks mostly outlive the
+ * threshold is predicted long-lived from then on.
+ * */
+class LifetimeAllocator : public Allocator
+{
+public:
+    enum class Lifetime { Unknown, Short, Long };
+
+    struct Counters
+    {
+        uint64_t shortAllocs;       // served as short-lived
+        uint64_t longAllocs;        // served as long-lived
+        uint64_t predictedLong;     // of the long-lived ones, how many were predicted rather than hinted
+        uint64_t regions;           // long-lived blocks the current region had no room for, which started a new one
+    };
+
+    // a block still live after longLived further allocations counts as long-lived
+    explicit LifetimeAllocator(BuddyAllocator &allocator, uint32_t longLived = 1024);
+
+    // predicts from the call site
+    char *alloc(uint16_t bytes) override;
+
+    // Unknown predicts from the call site, as above
+    char *alloc(uint16_t bytes, Lifetime hint);
+
+    void free(char *address) override;
+    void print() override;
+
+    const Counters &counters() const { return m_counters; }
+
+    // how much of the free memory is not in the largest free block, 0 when it is all in one piece
+    double fragmentation() const;
+
+private:
+    struct Site
+    {
+        uint32_t shortLived;
+        uint32_t longLived;
+    };
+
+    char *allocFrom(uint16_t bytes, uintptr_t site, Lifetime hint);
+    Lifetime predict(uintptr_t site) const;
+
+    BuddyAllocator &m_allocator;
+    uint32_t m_longLived;
+
+    uint64_t m_clock;                       // allocations so far
+    const char *m_region;                   // where the last long-lived block went, nullptr before the first
+    std::unordered_map<uintptr_t, Site> m_sites;
+
+    // per 8 byte unit of the arena, for the block starting there
+    std::vector<uint64_t> m_birth;
+    std::vector<uintptr_t> m_site;
+
+    Counters m_counters;
+};
+
+#endif // LIFETIMEALLOCATOR_H
@@ -0,0 +1,148 @@
+#include "LineAllocator.h"
+
+#include <iostream>
+
+namespace
+{
+    const uint32_t NoLine = ~uint32_t(0);
+    const uint8_t GranuleOrder = 3;
+    const uint8_t Granules = 8;
+}
+
+LineAllocator::LineAllocator(LockedAllocator &allocator) :
+    m_allocator(allocator),
+    m_state(new std::atomic<uint32_t>[allocator.capacity() >> LineOrder]),
+    m_lines(0)
+{
+    for (uint32_t line = 0; line < allocator.capacity() >> LineOrder; ++line) {
+        m_state[line].store(0, std::memory_order_relaxed);
+    }
+}
+
+LineAllocator::Local::Local(LineAllocator &lines) :
+    m_lines(lines),
+    m_line(NoLine)
+{
+}
+
+LineAllocator::Local::~Local()
+{
+    if (m_line != NoLine) {
+        m_lines.detach(m_line);
+    }
+}
+
+char *LineAllocator::Local::alloc(uint16_t bytes)
+{
+    if (bytes <= 0 || bytes > (1u << LineOrder) / 2) {
+        return m_lines.m_allocator.alloc(bytes);
+    }
+
+    // a power of two number of granules, aligned to its own size like any buddy block
+    uint8_t granules = 1;
+    while ((uint32_t(granules) << GranuleOrder) < bytes) {
+        granules <<= 1;
+    }
+    uint32_t run = (1u << granules) - 1;
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        if (m_line == NoLine) {
+            m_line = m_lines.takeLine();
+        }
+
+        // only we ever set bits, other threads only clear them, so what we see free stays free
+        std::atomic<uint32_t> &state = m_lines.m_state[m_line];
+        uint32_t used = state.load(std::memory_order_acquire) & Used;
+
+        for (uint8_t granule = 0; granule < Granules; granule += granules) {
+            if (!(used & (run << granule))) {
+                state.fetch_or((run << granule) | (1u << (granule + 8)), std::memory_order_acq_rel);
+                return m_lines.lineAddress(m_line) + (granule << GranuleOrder);
+            }
+        }
+
+        m_lines.detach(m_line);
+        m_line = NoLine;
+    }
+
+    // a fresh line always has room
+    throw "Insufficient Memory!";
+}
+
+uint32_t LineAllocator::takeLine()
+{
+    char *address = m_allocator.alloc(1 << LineOrder);
+    if (!m_allocator.inArena(address)) {
+        m_allocator.free(address);
+        throw "Insufficient Memory!";
+    }
+
+    uint32_t line = uint32_t((address - m_allocator.base()) >> LineOrder);
+    m_state[line].store(Owned, std::memory_order_release);
+    ++m_lines;
+    return line;
+}
+
+void LineAllocator::detach(uint32_t line)
+{
+    uint32_t old = m_state[line].fetch_or(Detached, std::memory_order_acq_rel);
+
+    // nothing left in it for anybody to free, so it is up to us
+    if (!(old & Used)) {
+        release(line);
+    }
+}
+
+void LineAllocator::release(uint32_t line)
+{
+    m_state[line].store(0, std::memory_order_relaxed);
+    --m_lines;
+    m_allocator.free(lineAddress(line));
+}
+
+void LineAllocator::free(char *address)
+{
+    if (!m_allocator.inArena(address)) {
+        m_allocator.free(address);
+        return;
+    }
+
+    uint64_t offset = address - m_allocator.base();
+    uint32_t line = uint32_t(offset >> LineOrder);
+    std::atomic<uint32_t> &state = m_state[line];
+
+    uint32_t current = state.load(std::memory_order_acquire);
+    if (!(current & Owned)) {
+        m_allocator.free(address);
+        return;
+    }
+
+    // the block runs from its start to the next start or the first granule not in use
+    uint8_t first = uint8_t((offset & ((1u << LineOrder) - 1)) >> GranuleOrder);
+    if (!(current & (1u << (first + 8)))) {
+        throw "Block is not reserved";
+    }
+
+    uint32_t bits = (1u << first) | (1u << (first + 8));
+    for (uint8_t granule = first + 1; granule < Granules; ++granule) {
+        if (!(current & (1u << granule)) || (current & (1u << (granule + 8)))) {
+            break;
+        }
+        bits |= 1u << granule;
+    }
+
+    uint32_t old = state.fetch_and(~bits, std::memory_order_acq_rel);
+
+    // the owner has moved on and we freed the last block, so the line is ours to hand back
+    if ((old & Detached) && !(old & Used & ~bits)) {
+        release(line);
+    }
+}
+
+void LineAllocator::print()
+{
+    m_allocator.print();
+
+    std::cout << "========= Lines =======" << std::endl << std::endl;
+    std::cout << m_lines.load() << " line(s) of " << (1u << LineOrder) << " bytes owned or waiting to be emptied" << std::endl << std::endl;
+}
@@ -0,0 +1,73 @@
+#ifndef LINEALLOCATOR_H
+#define LINEALLOCATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+
+#include "Allocator.h"
+#include "LockedAllocator.h"
+
+/*
+ * LineAllocator keeps small blocks of different threads off each other's cache lines. The buddy heap happily hands two
+ * threads the two halves of one 64 byte line, and then every write one of them makes evicts the line from the other's
+ * cache.
+ *
+ * Instead, every thread allocating through a Local takes whole 64 byte lines from the heap and carves its requests of
+ * up to 32 bytes out of those, in 8 byte granules; nobody else ever allocates from a line while its owner holds it.
+ * Anything larger is a whole line or more anyway and comes straight from the heap.
+ *
+ * Blocks may be freed from any thread, without a lock: each line has one atomic word with a bit for every granule in use
+ * and one for every granule that starts a block. When the owner has no room left it detaches the line and takes a new
+ * one, and whoever frees the last block of a detached line hands it back to the heap.
+ * */
+class LineAllocator
+{
+public:
+    static const uint8_t LineOrder = 6;
+
+    // one per thread
+    class Local : public Allocator
+    {
+    public:
+        explicit Local(LineAllocator &lines);
+        ~Local();
+
+        char *alloc(uint16_t bytes) override;
+        void free(char *address) override { m_lines.free(address); }
+        void print() override { m_lines.print(); }
+
+    private:
+        LineAllocator &m_lines;
+        uint32_t m_line;            // the line we carve from, NoLine before the first small request
+    };
+
+    explicit LineAllocator(LockedAllocator &allocator);
+
+    // from any thread
+    void free(char *address);
+    void print();
+
+    uint64_t lines() const { return m_lines.load(); }
+
+private:
+    // the state word of every line
+    static const uint32_t Used = 0xff;          // granules in use
+    static const uint32_t Starts = 0xff00;      // granules that start a block
+    static const uint32_t Detached = 1u << 16;  // the owner has moved on
+    static const uint32_t Owned = 1u << 17;     // the line is carved up by a Local, rather than a block of the heap
+
+    uint32_t takeLine();
+    void detach(uint32_t line);
+    void release(uint32_t line);
+
+    char *lineAddress(uint32_t line) const { return const_cast<char*>(m_allocator.base()) + (size_t(line) << LineOrder); }
+
+    LockedAllocator &m_allocator;
+
+    std::unique_ptr<std::atomic<uint32_t>[]> m_state;   // one per 64 bytes of the arena
+    std::atomic<uint64_t> m_lines;                      // lines currently owned or detached
+};
+
+#endif // LINEALLOCATOR_H
@@ -0,0 +1,47 @@
+#include "LockedAllocator.h"
+
+LockedAllocator::LockedAllocator(BuddyAllocator &allocator) :
+    m_allocator(allocator)
+{
+}
+
+char *LockedAllocator::alloc(uint16_t bytes)
+{
+    std::lock_guard<ProfiledMutex> lock(m_mutex);
+    return m_allocator.alloc(bytes);
+}
+
+void LockedAllocator::free(char *address)
+{
+    std::lock_guard<ProfiledMutex> lock(m_mutex);
+    m_allocator.free(address);
+}
+
+void LockedAllocator::print()
+{
+    std::lock_guard<ProfiledMutex> lock(m_mutex);
+    m_allocator.print();
+}
+
+void LockedAllocator::freeBatch(char *const *addresses, size_t count)
+{
+    std::lock_guard<ProfiledMutex> lock(m_mutex);
+    for (size_t i = 0; i < count; ++i) {
+        m_allocator.free(addresses[i]);
+    }
+}
+
+size_t LockedAllocator::blockSizes(char *const *addresses, size_t count)
+{
+    // blocks in the arena can be sized without the lock, only the map of mapped ones needs it
+    size_t bytes = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (m_allocator.inArena(addresses[i])) {
+            bytes += m_allocator.blockSize(addresses[i]);
+        } else {
+            std::lock_guard<ProfiledMutex> lock(m_mutex);
+            bytes += m_allocator.blockSize(addresses[i]);
+        }
+    }
+    return bytes;
+}
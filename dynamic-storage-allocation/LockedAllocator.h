@@ -0,0 +1,43 @@
+#ifndef LOCKEDALLOCATOR_H
+#define LOCKEDALLOCATOR_H
+
+#include <stddef.h>
+
+#include "Allocator.h"
+#include "BuddyAllocator.h"
+#include "ProfiledMutex.h"
+
+/*
+ * LockedAllocator makes a BuddyAllocator safe to share between threads by putting every call behind one mutex. The
+ * wrapped allocator must not be used directly while a LockedAllocator owns it.
+ * */
+class LockedAllocator : public Allocator
+{
+public:
+    explicit LockedAllocator(BuddyAllocator &allocator);
+
+    char *alloc(uint16_t bytes) override;
+    void free(char *address) override;
+    void print() override;
+
+    // frees them all, in the order given, for the price of a single lock
+    void freeBatch(char *const *addresses, size_t count) override;
+
+    // sum of BuddyAllocator::blockSize over all of them
+    size_t blockSizes(char *const *addresses, size_t count);
+    size_t blockSize(char *address) { return blockSizes(&address, 1); }
+
+    // fixed for the allocator's lifetime, no lock needed
+    bool inArena(const char *address) const { return m_allocator.inArena(address); }
+    const char *base() const { return m_allocator.base(); }
+    uint32_t capacity() const { return m_allocator.capacity(); }
+
+    // how much the one lock is fought over
+    ProfiledMutex::Stats lockStats() const { return m_mutex.stats(); }
+
+private:
+    BuddyAllocator &m_allocator;
+    ProfiledMutex m_mutex;
+};
+
+#endif // LOCKEDALLOCATOR_H
@@ -0,0 +1,94 @@
+#include "MappedRegion.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace
+{
+    // keep guarded buffers as aligned as anything malloc would hand out
+    const size_t Alignment = 16;
+
+    size_t pageSize()
+    {
+        static const size_t size = sysconf(_SC_PAGESIZE);
+        return size;
+    }
+
+    size_t roundUp(size_t bytes, size_t multiple)
+    {
+        return (bytes + multiple - 1) / multiple * multiple;
+    }
+}
+
+MappedRegion mapGuarded(uint16_t bytes, GuardPlacement placement)
+{
+    size_t page = pageSize();
+    size_t data = roundUp(bytes, page);
+
+    MappedRegion region;
+    region.length = data + page;
+    region.bytes = bytes;
+    region.guarded = true;
+    region.base = (char*) mmap(nullptr, region.length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (region.base == MAP_FAILED) {
+        throw "Insufficient Memory";
+    }
+
+    char *guard;
+    if (placement == GuardPlacement::After) {
+        guard = region.base + data;
+        region.address = guard - roundUp(bytes, Alignment);
+    } else {
+        guard = region.base;
+        region.address = region.base + page;
+    }
+
+    if (mprotect(guard, page, PROT_NONE) != 0) {
+        munmap(region.base, region.length);
+        throw "Insufficient Memory";
+    }
+
+    return region;
+}
+
+MappedRegion mapDirect(size_t bytes)
+{
+    MappedRegion region;
+    region.length = roundUp(bytes, pageSize());
+    region.bytes = bytes;
+    region.guarded = false;
+    region.base = (char*) mmap(nullptr, region.length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (region.base == MAP_FAILED) {
+        throw "Insufficient Memory";
+    }
+
+    region.address = region.base;
+    return region;
+}
+
+void remap(MappedRegion &region, size_t bytes)
+{
+    if (region.guarded) {
+        throw "Guarded regions cannot be remapped";
+    }
+
+    size_t length = roundUp(bytes, pageSize());
+    if (length != region.length) {
+        void *base = mremap(region.base, region.length, length, MREMAP_MAYMOVE);
+        if (base == MAP_FAILED) {
+            throw "Insufficient Memory";
+        }
+
+        region.base = region.address = (char*) base;
+        region.length = length;
+    }
+
+    region.bytes = bytes;
+}
+
+void unmap(const MappedRegion &region)
+{
+    munmap(region.base, region.length);
+}
@@ -0,0 +1,37 @@
+#ifndef MAPPEDREGION_H
+#define MAPPEDREGION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * MappedRegion is an allocation served straight from the kernel with mmap rather than from the buddy arena. Either:
+ * - a guarded one, for debugging large allocations with a PROT_NONE guard page on one side, so running off that end
+ *   faults immediately
+ * - a direct one, for allocations so large they would tie up the top of the arena. Those can grow and shrink in place
+ *   with mremap, the kernel moves the pages rather than us copying them.
+ * */
+enum class GuardPlacement
+{
+    After,      // overruns fault, the buffer ends flush against the guard page (give or take alignment)
+    Before      // underruns fault, the buffer starts right after the guard page
+};
+
+struct MappedRegion
+{
+    char *base;         // start of the mapping
+    size_t length;      // whole mapping, guard page included
+    char *address;      // what the caller got
+    size_t bytes;       // what the caller asked for
+    bool guarded;
+};
+
+MappedRegion mapGuarded(uint16_t bytes, GuardPlacement placement);
+MappedRegion mapDirect(size_t bytes);
+
+// resizes a direct region, which may move it
+void remap(MappedRegion &region, size_t bytes);
+
+void unmap(const MappedRegion &region);
+
+#endif // MAPPEDREGION_H
@@ -0,0 +1,47 @@
+#ifndef MEMORYPOISONING_H
+#define MEMORYPOISONING_H
+
+/*
+ * Lets AddressSanitizer and Valgrind's Memcheck see inside the arena. To them the whole arena is one big live allocation,
+ * so without these annotations a read of a free block, or past the end of a reserved one, goes unnoticed.
+ *
+ * - ASan builds (-fsanitize=address) poison automatically.
+ * - Memcheck annotations are switched on by defining BUDDY_VALGRIND (needs the valgrind headers).
+ * - Otherwise both macros expand to nothing but a cast to void.
+ * */
+
+#if defined(__SANITIZE_ADDRESS__)
+#  define BUDDY_ASAN 1
+#elif defined(__has_feature)
+#  if __has_feature(address_sanitizer)
+#    define BUDDY_ASAN 1
+#  endif
+#endif
+
+#if defined(BUDDY_ASAN)
+#  include <sanitizer/asan_interface.h>
+#  define BUDDY_ASAN_POISON(address, bytes) ASAN_POISON_MEMORY_REGION((address), (bytes))
+#  define BUDDY_ASAN_UNPOISON(address, bytes) ASAN_UNPOISON_MEMORY_REGION((address), (bytes))
+#else
+#  define BUDDY_ASAN_POISON(address, bytes) ((void)(address), (void)(bytes))
+#  define BUDDY_ASAN_UNPOISON(address, bytes) ((void)(address), (void)(bytes))
+#endif
+
+#if defined(BUDDY_VALGRIND)
+#  include <valgrind/memcheck.h>
+#  define BUDDY_VALGRIND_POISON(address, bytes) VALGRIND_MAKE_MEM_NOACCESS((address), (bytes))
+#  define BUDDY_VALGRIND_UNPOISON(address, bytes) VALGRIND_MAKE_MEM_UNDEFINED((address), (bytes))
+#else
+#  define BUDDY_VALGRIND_POISON(address, bytes) ((void)(address), (void)(bytes))
+#  define BUDDY_VALGRIND_UNPOISON(address, bytes) ((void)(address), (void)(bytes))
+#endif
+
+// nobody may touch [address, address + bytes) until it is unpoisoned
+#define POISON_MEMORY(address, bytes) \
+    do { BUDDY_ASAN_POISON(address, bytes); BUDDY_VALGRIND_POISON(address, bytes); } while (0)
+
+// [address, address + bytes) is usable again, though its contents are undefined
+#define UNPOISON_MEMORY(address, bytes) \
+    do { BUDDY_ASAN_UNPOISON(address, bytes); BUDDY_VALGRIND_UNPOISON(address, bytes); } while (0)
+
+#endif // MEMORYPOISONING_H
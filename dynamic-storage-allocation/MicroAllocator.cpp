@@ -0,0 +1,155 @@
+#include "MicroAllocator.h"
+
+#include <iostream>
+#include <new>
+
+namespace
+{
+    // an empty page, with the cells past the end of it taken for good
+    uint64_t emptyPage(uint8_t cellOrder)
+    {
+        uint32_t cells = ((1u << MicroAllocator::PageOrder) - MicroAllocator::HeaderBytes) >> cellOrder;
+        return ~uint64_t(0) << cells;
+    }
+
+    uint8_t cellOrderFor(uint16_t bytes)
+    {
+        return bytes <= 1 ? 0 : bytes <= 2 ? 1 : 2;
+    }
+}
+
+MicroAllocator::MicroAllocator(BuddyAllocator &allocator) :
+    m_allocator(allocator),
+    m_ours(((allocator.capacity() >> PageOrder) + 63) / 64, 0),
+    m_liveCells(0),
+    m_pages(0)
+{
+}
+
+MicroAllocator::~MicroAllocator()
+{
+    // cells still live go down with their pages
+    for (uint32_t word = 0; word < m_ours.size(); ++word) {
+        for (uint64_t bits = m_ours[word]; bits; bits &= bits - 1) {
+            m_allocator.free(pageAddress(word * 64 + __builtin_ctzll(bits)));
+        }
+    }
+}
+
+char *MicroAllocator::alloc(uint16_t bytes)
+{
+    if (bytes <= 0 || bytes > 4) {
+        return m_allocator.alloc(bytes);
+    }
+
+    uint8_t cellOrder = cellOrderFor(bytes);
+    std::vector<uint32_t> &partial = m_partial[cellOrder];
+
+    uint32_t page;
+    if (!partial.empty()) {
+        page = partial.back();
+    } else {
+        char *address = m_allocator.alloc(1 << PageOrder);
+        if (!m_allocator.inArena(address)) {
+            // mapped, so the page has no slot of ours to keep its mask in
+            m_allocator.free(address);
+            throw "Insufficient Memory!";
+        }
+
+        page = uint32_t((address - m_allocator.base()) >> PageOrder);
+        new (address) Page{ emptyPage(cellOrder), 0, cellOrder };
+        setOurs(page, true);
+        list(page);
+        ++m_pages;
+    }
+
+    Page &header = descriptor(page);
+    uint8_t cell = __builtin_ctzll(~header.used);
+    header.used |= uint64_t(1) << cell;
+
+    if (header.used == ~uint64_t(0)) {
+        unlist(page);
+    }
+
+    ++m_liveCells;
+    return pageAddress(page) + HeaderBytes + (size_t(cell) << cellOrder);
+}
+
+void MicroAllocator::free(char *address)
+{
+    // mapped blocks, and arena blocks that are not our pages, are the heap's
+    if (!m_allocator.inArena(address)) {
+        m_allocator.free(address);
+        return;
+    }
+
+    uint64_t offset = uint64_t(address - m_allocator.base());
+    uint32_t page = uint32_t(offset >> PageOrder);
+
+    if (!ours(page)) {
+        m_allocator.free(address);
+        return;
+    }
+
+    Page &header = descriptor(page);
+    uint64_t within = offset & ((1u << PageOrder) - 1);
+    if (within < HeaderBytes || ((within - HeaderBytes) & ((1u << header.cellOrder) - 1))) {
+        throw "Block is not reserved";
+    }
+
+    uint64_t bit = uint64_t(1) << ((within - HeaderBytes) >> header.cellOrder);
+    if (!(header.used & bit)) {
+        throw "Block is not reserved";
+    }
+
+    if (header.used == ~uint64_t(0)) {
+        list(page);
+    }
+
+    header.used &= ~bit;
+    --m_liveCells;
+
+    // hand empty pages back, but keep the last one around so a single cell coming and going does not thrash the heap
+    if (header.used == emptyPage(header.cellOrder) && m_partial[header.cellOrder].size() > 1) {
+        unlist(page);
+        setOurs(page, false);
+        --m_pages;
+        m_allocator.free(pageAddress(page));
+    }
+}
+
+void MicroAllocator::setOurs(uint32_t page, bool ours)
+{
+    uint64_t bit = uint64_t(1) << (page & 63);
+    m_ours[page >> 6] = ours ? m_ours[page >> 6] | bit : m_ours[page >> 6] & ~bit;
+}
+
+void MicroAllocator::list(uint32_t page)
+{
+    Page &header = descriptor(page);
+    std::vector<uint32_t> &partial = m_partial[header.cellOrder];
+    header.slot = uint32_t(partial.size());
+    partial.push_back(page);
+}
+
+void MicroAllocator::unlist(uint32_t page)
+{
+    Page &header = descriptor(page);
+    std::vector<uint32_t> &partial = m_partial[header.cellOrder];
+    uint32_t last = partial.back();
+
+    partial[header.slot] = last;
+    descriptor(last).slot = header.slot;
+    partial.pop_back();
+}
+
+void MicroAllocator::print()
+{
+    m_allocator.print();
+
+    std::cout << "========= Micro Cells =======" << std::endl << std::endl;
+    for (uint8_t cellOrder = 0; cellOrder < CellOrders; ++cellOrder) {
+        std::cout << "{ " << (1u << cellOrder) << " byte cells: " << m_partial[cellOrder].size() << " page(s) with room }" << std::endl;
+    }
+    std::cout << m_liveCells << " cell(s) in " << m_pages << " page(s) of " << (1u << PageOrder) << " bytes" << std::endl << std::endl;
+}
@@ -0,0 +1,70 @@
+#ifndef MICROALLOCATOR_H
+#define MICROALLOCATOR_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "Allocator.h"
+#include "BuddyAllocator.h"
+
+/*
+ * MicroAllocator serves the sizes the buddy heap does not bother with. The smallest block is 8 bytes, so a one byte flag
+ * or a four byte id wastes most of its block. Requests of up to 4 bytes are instead packed as 1, 2 or 4 byte cells into
+ * 64 byte pages taken from the heap, every page holding cells of a single size; anything larger goes to the heap as is.
+ *
+ * A page starts with a 16 byte header holding a 64 bit mask of which of its cells are taken, so the first free cell is
+ * one count of trailing zeros away, which leaves 48 bytes for cells. Beside the arena there is only one bit per 64 bytes,
+ * telling our pages from the heap's blocks, so the bookkeeping grows with the pages actually in use rather than with the
+ * arena. Pages with a free cell are kept on a list per cell size, and a page goes back to the heap as soon as its last
+ * cell is freed, unless it is the only one left for its size.
+ * */
+class MicroAllocator : public Allocator
+{
+public:
+    static const uint8_t PageOrder = 6;
+    static const uint8_t HeaderBytes = 16;    // at the start of every page, cells come after it
+
+    explicit MicroAllocator(BuddyAllocator &allocator);
+    ~MicroAllocator();
+
+    char *alloc(uint16_t bytes) override;
+    void free(char *address) override;
+    void print() override;
+
+    uint64_t liveCells() const { return m_liveCells; }
+    uint64_t pages() const { return m_pages; }
+
+    // what telling our pages apart takes beside the arena
+    size_t indexBytes() const { return m_ours.size() * sizeof(uint64_t); }
+
+private:
+    static const uint8_t CellOrders = 3;      // 1, 2 and 4 byte cells
+
+    // the header
+    struct Page
+    {
+        uint64_t used;              // bit i is set while cell i is taken, cells a page has no room for count as taken
+        uint32_t slot;              // where the page sits in its m_partial list
+        uint8_t cellOrder;
+    };
+    static_assert(sizeof(Page) <= HeaderBytes, "the header has to fit in front of the cells");
+
+    char *pageAddress(uint32_t page) const { return const_cast<char*>(m_allocator.base()) + (size_t(page) << PageOrder); }
+    Page &descriptor(uint32_t page) const { return *reinterpret_cast<Page*>(pageAddress(page)); }
+
+    bool ours(uint32_t page) const { return (m_ours[page >> 6] >> (page & 63)) & 1; }
+    void setOurs(uint32_t page, bool ours);
+
+    void list(uint32_t page);
+    void unlist(uint32_t page);
+
+    BuddyAllocator &m_allocator;
+
+    std::vector<uint64_t> m_ours;                   // bit i is set while the i-th 64 bytes of the arena are one of our pages
+    std::vector<uint32_t> m_partial[CellOrders];    // pages with a free cell, per cell size
+
+    uint64_t m_liveCells;
+    uint64_t m_pages;
+};
+
+#endif // MICROALLOCATOR_H
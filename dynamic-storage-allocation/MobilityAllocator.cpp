@@ -0,0 +1,133 @@
+#include "MobilityAllocator.h"
+
+#include <iostream>
+
+namespace
+{
+    // label of a region nothing lives in
+    const uint8_t Unlabelled = 0xff;
+
+    // where each mobility looks when there is neither a region of its own nor a free one, least harmful first
+    const MobilityAllocator::Mobility fallbacks[3][2] = {
+        { MobilityAllocator::Mobility::Reclaimable, MobilityAllocator::Mobility::Unmovable },   // Movable
+        { MobilityAllocator::Mobility::Unmovable,   MobilityAllocator::Mobility::Movable },     // Reclaimable
+        { MobilityAllocator::Mobility::Reclaimable, MobilityAllocator::Mobility::Movable },     // Unmovable
+    };
+
+    const char *names[3] = { "movable", "reclaimable", "unmovable" };
+
+    uint8_t regionOrderFor(const BuddyAllocator &allocator, uint8_t regionOrder)
+    {
+        if (regionOrder == 0) {
+            regionOrder = allocator.order() > 5 ? allocator.order() - 2 : allocator.order();
+        }
+        if (regionOrder > allocator.order()) {
+            throw "Invalid order";
+        }
+        return regionOrder;
+    }
+}
+
+MobilityAllocator::MobilityAllocator(BuddyAllocator &allocator, uint8_t regionOrder) :
+    m_allocator(allocator),
+    m_regionOrder(regionOrderFor(allocator, regionOrder)),
+    m_label(allocator.capacity() >> m_regionOrder, Unlabelled),
+    m_live(allocator.capacity() >> m_regionOrder),
+    m_recent(),
+    m_counters()
+{
+}
+
+char *MobilityAllocator::alloc(uint16_t bytes)
+{
+    return alloc(bytes, Mobility::Unmovable);
+}
+
+char *MobilityAllocator::alloc(uint16_t bytes, Mobility mobility)
+{
+    // a block of a whole region or more has no neighbours to mix with
+    if (BuddyAllocator::orderFor(bytes) >= m_regionOrder) {
+        return m_allocator.alloc(bytes);
+    }
+
+    uint8_t own = uint8_t(mobility);
+    uint32_t regions = uint32_t(m_label.size());
+
+    uint32_t recent = m_recent[own];
+    if (m_label[recent] == own) {
+        if (char *address = allocIn(recent, bytes)) {
+            return address;
+        }
+    }
+
+    for (uint32_t region = 0; region < regions; ++region) {
+        if (m_label[region] == own && region != recent) {
+            if (char *address = allocIn(region, bytes)) {
+                m_recent[own] = region;
+                return address;
+            }
+        }
+    }
+
+    for (uint32_t region = 0; region < regions; ++region) {
+        if (m_label[region] == Unlabelled) {
+            if (char *address = allocIn(region, bytes)) {
+                m_label[region] = own;
+                m_recent[own] = region;
+                ++m_counters.claims;
+                return address;
+            }
+        }
+    }
+
+    for (Mobility other : fallbacks[own]) {
+        for (uint32_t region = 0; region < regions; ++region) {
+            if (m_label[region] == uint8_t(other)) {
+                if (char *address = allocIn(region, bytes)) {
+                    ++m_counters.fallbacks;
+                    return address;
+                }
+            }
+        }
+    }
+
+    // nowhere to put it, let the heap say so
+    return m_allocator.alloc(bytes);
+}
+
+char *MobilityAllocator::allocIn(uint32_t region, uint16_t bytes)
+{
+    char *address = m_allocator.tryAllocNear(bytes, m_allocator.base() + (uint64_t(region) << m_regionOrder), m_regionOrder);
+    if (address) {
+        ++m_live[region];
+    }
+    return address;
+}
+
+void MobilityAllocator::free(char *address)
+{
+    // mapped blocks live elsewhere, and blocks of a whole region or more were never counted
+    bool counted = m_allocator.inArena(address);
+    uint32_t region = counted ? uint32_t(uint64_t(address - m_allocator.base()) >> m_regionOrder) : 0;
+    m_allocator.free(address);
+
+    if (!counted) {
+        return;
+    }
+
+    if (m_live[region] && --m_live[region] == 0) {
+        m_label[region] = Unlabelled;
+    }
+}
+
+void MobilityAllocator::print()
+{
+    m_allocator.print();
+
+    std::cout << "========= Mobility =======" << std::endl << std::endl;
+    for (size_t region = 0; region < m_label.size(); ++region) {
+        std::cout << "{ Region( " << (void*)(m_allocator.base() + (region << m_regionOrder)) << ", "
+                  << (m_label[region] == Unlabelled ? "free" : names[m_label[region]]) << ", " << m_live[region] << " blocks ) }" << std::endl;
+    }
+    std::cout << "claims " << m_counters.claims << ", fallbacks " << m_counters.fallbacks << std::endl << std::endl;
+}
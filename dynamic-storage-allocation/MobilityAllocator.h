@@ -0,0 +1,61 @@
+#ifndef MOBILITYALLOCATOR_H
+#define MOBILITYALLOCATOR_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "Allocator.h"
+#include "BuddyAllocator.h"
+
+/*
+ * MobilityAllocator groups allocations by how easily they can be got rid of, the way the kernel's page allocator groups
+ * pageblocks by migrate type. The arena is cut into regions of 2^regionOrder bytes and every region in use carries the
+ * mobility of whatever was first put in it:
+ *
+ * - Movable blocks are only reached through handles and could be moved elsewhere
+ * - Reclaimable blocks are caches that can be dropped when memory runs short
+ * - Unmovable blocks stay put until their owner frees them
+ *
+ * An allocation goes into a region of its own mobility if one has room, otherwise it claims a region that is wholly
+ * free, and only when there is neither does it fall back to a region of another mobility. An unmovable block can then
+ * only ever pin regions that are unmovable already, so the others keep coalescing back into whole regions. A region
+ * loses its label as soon as it is empty again.
+ * */
+class MobilityAllocator : public Allocator
+{
+public:
+    enum class Mobility : uint8_t { Movable, Reclaimable, Unmovable };
+
+    struct Counters
+    {
+        uint64_t claims;            // free regions taken over by a mobility
+        uint64_t fallbacks;         // allocations that had to go into another mobility's region
+    };
+
+    // A region is also the largest block grouping can keep coming back, so regionOrder should be at least the order of
+    // the largest block that matters. 0 picks a quarter of the arena
+    explicit MobilityAllocator(BuddyAllocator &allocator, uint8_t regionOrder = 0);
+
+    // unmovable, like anything else that does not say otherwise
+    char *alloc(uint16_t bytes) override;
+    char *alloc(uint16_t bytes, Mobility mobility);
+
+    void free(char *address) override;
+    void print() override;
+
+    const Counters &counters() const { return m_counters; }
+
+private:
+    char *allocIn(uint32_t region, uint16_t bytes);
+
+    BuddyAllocator &m_allocator;
+    uint8_t m_regionOrder;
+
+    std::vector<uint8_t> m_label;               // Mobility of each region, Unlabelled while it is empty
+    std::vector<uint32_t> m_live;               // reserved blocks starting in each region
+    uint32_t m_recent[3];                       // region each mobility last allocated from, tried first
+
+    Counters m_counters;
+};
+
+#endif // MOBILITYALLOCATOR_H
@@ -0,0 +1,374 @@
+#include "PerCpuCache.h"
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sched.h>
+#include <thread>
+#include <unistd.h>
+#include <xmmintrin.h>
+
+#if defined(__x86_64__) && defined(__linux__) && __has_include(<sys/rseq.h>)
+#define PERCPUCACHE_RSEQ
+#include <sys/rseq.h>
+#endif
+
+namespace
+{
+#ifdef PERCPUCACHE_RSEQ
+    /*
+     * Every critical section below follows the same pattern. It points the thread's rseq area at a descriptor giving its
+     * start (1), the end of its commit (2) and its abort handler (4), then reads the CPU number, finds that CPU's magazine
+     * and does its work, the last instruction being the one store that publishes it. The abort handler, which the kernel
+     * wants to see preceded by RSEQ_SIG, leaves for the C++ side to start over.
+     *
+     * The magazine of CPU i for the order at hand is found at count + i * stride and blocks + i * stride, and the CPU
+     * number is checked against cpus first: if the kernel knows a CPU we have no cache for, or has not filled in the
+     * number yet, the section exits to unavailable.
+     * */
+    #define RSEQ_SIG_STRING "0x53053053"
+    static_assert(RSEQ_SIG == 0x53053053, "RSEQ_SIG_STRING is out of date");
+
+    #define RSEQ_BEGIN                                                  \
+        ".pushsection __rseq_cs, \"aw\"\n\t"                          \
+        ".balign 32\n\t"                                               \
+        "3:\n\t"                                                       \
+        ".long 0x0, 0x0\n\t"                                           \
+        ".quad 1f, (2f - 1f), 4f\n\t"                                  \
+        ".popsection\n\t"                                              \
+        "leaq 3b(%%rip), %%rax\n\t"                                    \
+        "movq %%rax, %c[csOffset](%[area])\n\t"                        \
+        "1:\n\t"                                                       \
+        "movl %c[cpuOffset](%[area]), %%eax\n\t"                       \
+        "cmpq %[cpus], %%rax\n\t"                                      \
+        "jae %l[unavailable]\n\t"                                      \
+        "imulq %[stride], %%rax\n\t"
+
+    #define RSEQ_END                                                    \
+        "2:\n\t"                                                       \
+        ".pushsection __rseq_failure, \"ax\"\n\t"                     \
+        ".byte 0x0f, 0xb9, 0x3d\n\t"                                   \
+        ".long " RSEQ_SIG_STRING "\n\t"                                \
+        "4:\n\t"                                                       \
+        "jmp %l[aborted]\n\t"                                          \
+        ".popsection\n\t"
+
+    enum class Outcome { Done, Empty, Full, Unavailable };
+
+    struct Magazines
+    {
+        char *count;
+        char *blocks;
+        char *hits;
+        char *misses;
+        uint64_t stride;
+        uint64_t cpus;
+    };
+
+    template <typename Cpu>
+    Magazines magazinesOf(Cpu *cpus, size_t count, uint8_t k)
+    {
+        return Magazines{ reinterpret_cast<char*>(&cpus[0].count[k]), reinterpret_cast<char*>(cpus[0].blocks[k]),
+                          reinterpret_cast<char*>(&cpus[0].hits), reinterpret_cast<char*>(&cpus[0].misses),
+                          sizeof(Cpu), count };
+    }
+
+    struct rseq *rseqArea()
+    {
+        return reinterpret_cast<struct rseq*>(static_cast<char*>(__builtin_thread_pointer()) + __rseq_offset);
+    }
+
+    Outcome rseqPop(const Magazines &magazines, char **address)
+    {
+        struct rseq *area = rseqArea();
+
+    retry:
+        __asm__ __volatile__ goto (
+            RSEQ_BEGIN
+            "movzwl (%[count], %%rax), %%ecx\n\t"
+            "testl %%ecx, %%ecx\n\t"
+            "jnz 5f\n\t"
+            "addq $1, (%[misses], %%rax)\n\t"
+            "jmp %l[empty]\n\t"
+            "5:\n\t"
+            "subl $1, %%ecx\n\t"
+            "leaq (%[blocks], %%rax), %%rdx\n\t"
+            "movq (%%rdx, %%rcx, 8), %%rdx\n\t"
+            "movq %%rdx, (%[address])\n\t"
+            "addq $1, (%[hits], %%rax)\n\t"
+            "movw %%cx, (%[count], %%rax)\n\t"
+            RSEQ_END
+            :
+            : [area] "r" (area), [csOffset] "i" (offsetof(struct rseq, rseq_cs)), [cpuOffset] "i" (offsetof(struct rseq, cpu_id)),
+              [cpus] "r" (magazines.cpus), [stride] "r" (magazines.stride), [count] "r" (magazines.count),
+              [blocks] "r" (magazines.blocks), [hits] "r" (magazines.hits), [misses] "r" (magazines.misses),
+              [address] "r" (address)
+            : "rax", "rcx", "rdx", "memory", "cc"
+            : aborted, empty, unavailable);
+        return Outcome::Done;
+
+    aborted:
+        goto retry;
+    empty:
+        return Outcome::Empty;
+    unavailable:
+        return Outcome::Unavailable;
+    }
+
+    Outcome rseqPush(const Magazines &magazines, char *address, uint16_t capacity)
+    {
+        struct rseq *area = rseqArea();
+
+    retry:
+        __asm__ __volatile__ goto (
+            RSEQ_BEGIN
+            "movzwl (%[count], %%rax), %%ecx\n\t"
+            "cmpl %[capacity], %%ecx\n\t"
+            "jae %l[full]\n\t"
+            "leaq (%[blocks], %%rax), %%rdx\n\t"
+            "movq %[address], (%%rdx, %%rcx, 8)\n\t"
+            "addl $1, %%ecx\n\t"
+            "movw %%cx, (%[count], %%rax)\n\t"
+            RSEQ_END
+            :
+            : [area] "r" (area), [csOffset] "i" (offsetof(struct rseq, rseq_cs)), [cpuOffset] "i" (offsetof(struct rseq, cpu_id)),
+              [cpus] "r" (magazines.cpus), [stride] "r" (magazines.stride), [count] "r" (magazines.count),
+              [blocks] "r" (magazines.blocks), [address] "r" (address), [capacity] "r" (uint32_t(capacity))
+            : "rax", "rcx", "rdx", "memory", "cc"
+            : aborted, full, unavailable);
+        return Outcome::Done;
+
+    aborted:
+        goto retry;
+    full:
+        return Outcome::Full;
+    unavailable:
+        return Outcome::Unavailable;
+    }
+
+    // moves the top half of a full magazine to spill and returns how many that was, 0 if the magazine was not full.
+    // Nothing is written to the magazine but the count, so unlike the flag based fallback this gives back the most
+    // recently freed half
+    size_t rseqSpill(const Magazines &magazines, char **spill, uint16_t capacity)
+    {
+        struct rseq *area = rseqArea();
+        uint64_t half = capacity / 2;
+
+    retry:
+        __asm__ __volatile__ goto (
+            RSEQ_BEGIN
+            "movzwl (%[count], %%rax), %%ecx\n\t"
+            "cmpl %[capacity], %%ecx\n\t"
+            "jne %l[unavailable]\n\t"
+            "leaq (%[blocks], %%rax), %%rsi\n\t"
+            "leaq (%%rsi, %[half], 8), %%rsi\n\t"
+            "movq %[spill], %%rdi\n\t"
+            "movl %k[half], %%ecx\n\t"
+            "rep movsq\n\t"
+            "movw %w[half], (%[count], %%rax)\n\t"
+            RSEQ_END
+            :
+            : [area] "r" (area), [csOffset] "i" (offsetof(struct rseq, rseq_cs)), [cpuOffset] "i" (offsetof(struct rseq, cpu_id)),
+              [cpus] "r" (magazines.cpus), [stride] "r" (magazines.stride), [count] "r" (magazines.count),
+              [blocks] "r" (magazines.blocks), [spill] "r" (spill), [capacity] "r" (uint32_t(capacity)), [half] "r" (half)
+            : "rax", "rcx", "rsi", "rdi", "memory", "cc"
+            : aborted, unavailable);
+        return size_t(half);
+
+    aborted:
+        goto retry;
+    unavailable:
+        return 0;
+    }
+#endif
+}
+
+PerCpuCache::PerCpuCache(LockedAllocator &allocator, uint8_t maxOrder, bool useRseq) :
+    m_allocator(allocator),
+    m_maxOrder(maxOrder > BuddyAllocator::MaxOrder ? BuddyAllocator::MaxOrder : maxOrder),
+    m_rseq(false),
+    m_cpuCount(0),
+    m_cpus(nullptr)
+{
+#ifdef PERCPUCACHE_RSEQ
+    // glibc registers every thread, or none when it is told not to or the kernel lacks rseq
+    m_rseq = useRseq && __rseq_size > 0;
+#else
+    (void)useRseq;
+#endif
+
+    long cpus = sysconf(_SC_NPROCESSORS_CONF);
+    m_cpuCount = cpus > 0 ? size_t(cpus) : 1;
+
+    // new only promises alignas(64) from C++17 on
+    m_cpus = (Cpu*) _mm_malloc(m_cpuCount * sizeof(Cpu), alignof(Cpu));
+    for (size_t cpu = 0; cpu < m_cpuCount; ++cpu) {
+        new (&m_cpus[cpu]) Cpu();
+        m_cpus[cpu].busy.clear();
+    }
+}
+
+PerCpuCache::~PerCpuCache()
+{
+    flush();
+
+    for (size_t cpu = 0; cpu < m_cpuCount; ++cpu) {
+        m_cpus[cpu].~Cpu();
+    }
+    _mm_free(m_cpus);
+}
+
+PerCpuCache::Cpu &PerCpuCache::current()
+{
+    int cpu = sched_getcpu();
+    if (cpu < 0) {
+        static thread_local size_t hash = std::hash<std::thread::id>()(std::this_thread::get_id());
+        return m_cpus[hash % m_cpuCount];
+    }
+    return m_cpus[size_t(cpu) % m_cpuCount];
+}
+
+char *PerCpuCache::alloc(uint16_t bytes)
+{
+    if (bytes <= 0) {
+        throw "Har har har";
+    }
+
+    uint8_t k = BuddyAllocator::orderFor(bytes);
+    if (k > m_maxOrder) {
+        return m_allocator.alloc(bytes);
+    }
+
+    if (char *address = pop(k)) {
+        return address;
+    }
+
+    // a whole block, so that it fits the magazine of its order when it is freed
+    return m_allocator.alloc(uint16_t(std::min(1u << k, 0xffffu)));
+}
+
+void PerCpuCache::free(char *address)
+{
+    // only power of two sized blocks are what alloc hands out for their order, mapped allocations may be anything
+    size_t size = m_allocator.blockSize(address);
+    if (size > (size_t(1) << m_maxOrder) || (size & (size - 1))) {
+        m_allocator.free(address);
+        return;
+    }
+
+    if (!push(uint8_t(__builtin_ctzll(size)), address)) {
+        m_allocator.free(address);
+    }
+}
+
+char *PerCpuCache::pop(uint8_t k)
+{
+#ifdef PERCPUCACHE_RSEQ
+    if (m_rseq) {
+        Magazines magazines = magazinesOf(m_cpus, m_cpuCount, k);
+        char *address = nullptr;
+        return rseqPop(magazines, &address) == Outcome::Done ? address : nullptr;
+    }
+#endif
+
+    Cpu &cpu = current();
+    if (cpu.busy.test_and_set(std::memory_order_acquire)) {
+        return nullptr;
+    }
+
+    char *address = nullptr;
+    if (cpu.count[k]) {
+        address = cpu.blocks[k][--cpu.count[k]];
+        ++cpu.hits;
+    } else {
+        ++cpu.misses;
+    }
+
+    cpu.busy.clear(std::memory_order_release);
+    return address;
+}
+
+bool PerCpuCache::push(uint8_t k, char *address)
+{
+    char *spill[MagazineSize / 2];
+    size_t spilled = 0;
+
+#ifdef PERCPUCACHE_RSEQ
+    if (m_rseq) {
+        Magazines magazines = magazinesOf(m_cpus, m_cpuCount, k);
+
+        // a full magazine gives half of it back, then we try again, on whichever CPU we are on by then
+        Outcome outcome;
+        while ((outcome = rseqPush(magazines, address, MagazineSize)) == Outcome::Full) {
+            if ((spilled = rseqSpill(magazines, spill, MagazineSize))) {
+                std::sort(spill, spill + spilled);
+                m_allocator.freeBatch(spill, spilled);
+            }
+        }
+        return outcome == Outcome::Done;
+    }
+#endif
+
+    Cpu &cpu = current();
+    if (cpu.busy.test_and_set(std::memory_order_acquire)) {
+        return false;
+    }
+
+    if (cpu.count[k] == MagazineSize) {
+        // keep the most recently freed half, those are the ones still warm in the cache
+        spilled = MagazineSize / 2;
+        std::copy(cpu.blocks[k], cpu.blocks[k] + spilled, spill);
+        std::copy(cpu.blocks[k] + spilled, cpu.blocks[k] + MagazineSize, cpu.blocks[k]);
+        cpu.count[k] -= spilled;
+    }
+    cpu.blocks[k][cpu.count[k]++] = address;
+
+    cpu.busy.clear(std::memory_order_release);
+
+    if (spilled) {
+        std::sort(spill, spill + spilled);
+        m_allocator.freeBatch(spill, spilled);
+    }
+    return true;
+}
+
+void PerCpuCache::flush()
+{
+    for (size_t i = 0; i < m_cpuCount; ++i) {
+        Cpu &cpu = m_cpus[i];
+        while (cpu.busy.test_and_set(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+
+        for (int k = 0; k <= m_maxOrder; ++k) {
+            m_allocator.freeBatch(cpu.blocks[k], cpu.count[k]);
+            cpu.count[k] = 0;
+        }
+
+        cpu.busy.clear(std::memory_order_release);
+    }
+}
+
+void PerCpuCache::print()
+{
+    m_allocator.print();
+
+    // with rseq the flags keep nobody out, so this is only a snapshot
+    std::cout << "========= Per CPU Caches =======" << std::endl << std::endl;
+    for (size_t i = 0; i < m_cpuCount; ++i) {
+        Cpu &cpu = m_cpus[i];
+        while (cpu.busy.test_and_set(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+
+        size_t cached = 0;
+        for (int k = 0; k <= m_maxOrder; ++k) {
+            cached += size_t(cpu.count[k]) << k;
+        }
+        std::cout << "{ CPU " << i << ": " << cached << " bytes cached, hits " << cpu.hits << ", misses " << cpu.misses << " }" << std::endl;
+
+        cpu.busy.clear(std::memory_order_release);
+    }
+    std::cout << std::endl;
+}
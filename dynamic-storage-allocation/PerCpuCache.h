@@ -0,0 +1,78 @@
+#ifndef PERCPUCACHE_H
+#define PERCPUCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "Allocator.h"
+#include "BuddyAllocator.h"
+#include "LockedAllocator.h"
+
+/*
+ * PerCpuCache keeps small free blocks in front of a shared heap, one cache per CPU rather than per thread. A cache per
+ * thread multiplies what sits idle in caches by the number of threads; with one per CPU, a pool of hundreds of threads
+ * shares a few dozen caches, and a thread almost always finds its CPU's cache to itself.
+ *
+ * Every CPU has a magazine of up to MagazineSize blocks for each cached order. alloc pops from the calling CPU's magazine
+ * and only goes to the heap when it is empty; free pushes onto it, and when it is full half of it goes back to the heap
+ * in one batch.
+ *
+ * On x86-64 Linux with a C library that registers restartable sequences (glibc 2.35 on), every magazine update is an rseq
+ * critical section: read the CPU number the kernel keeps in the thread's rseq area, work on that CPU's magazine, and
+ * commit with a single store. If the thread is preempted, migrated or signalled before the commit the kernel sends it to
+ * the abort handler, and it starts over. The fast path has no atomic instructions and takes no lock.
+ *
+ * Without rseq each CPU's magazines sit behind a flag instead, only ever contended when a thread is preempted or migrated
+ * halfway through, and the CPU comes from sched_getcpu(), or the thread's id when that fails. A thread finding the flag
+ * taken does not wait, it goes to the heap.
+ * */
+class PerCpuCache : public Allocator
+{
+public:
+    static const size_t MagazineSize = 32;
+
+    // blocks up to 2^maxOrder bytes are cached. useRseq false forces the flag based fallback
+    explicit PerCpuCache(LockedAllocator &allocator, uint8_t maxOrder = 10, bool useRseq = true);
+
+    // everything cached goes back to the heap
+    ~PerCpuCache();
+
+    char *alloc(uint16_t bytes) override;
+    void free(char *address) override;
+    void print() override;
+
+    // hands every cached block back to the heap. With rseq nothing stops another CPU's threads meanwhile, so only while
+    // no other thread is using the cache
+    void flush();
+
+    size_t cpus() const { return m_cpuCount; }
+    bool usesRseq() const { return m_rseq; }
+
+private:
+    struct alignas(64) Cpu
+    {
+        std::atomic_flag busy;                                      // only without rseq
+        uint16_t count[BuddyAllocator::MaxOrder + 1];
+        char *blocks[BuddyAllocator::MaxOrder + 1][MagazineSize];
+
+        // statistics. Under rseq an aborted critical section may count twice
+        uint64_t hits;
+        uint64_t misses;
+    };
+
+    Cpu &current();
+
+    // from and onto the calling CPU's magazine: nullptr when it is empty, false when the block has to go to the heap
+    char *pop(uint8_t k);
+    bool push(uint8_t k, char *address);
+
+    LockedAllocator &m_allocator;
+    uint8_t m_maxOrder;
+    bool m_rseq;
+
+    size_t m_cpuCount;
+    Cpu *m_cpus;
+};
+
+#endif // PERCPUCACHE_H
@@ -0,0 +1,215 @@
+#include "PersistentHeap.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    const uint32_t Magic = 0x48505542;  // "BUPH"
+
+    // the smallest block we hand out is 8 bytes
+    const uint8_t MinOrder = 3;
+
+    // a split writes one tag per order on the way down plus the block itself, a coalesce just one
+    const uint32_t LogCapacity = 64;
+
+    size_t pageSize()
+    {
+        static const size_t size = sysconf(_SC_PAGESIZE);
+        return size;
+    }
+
+    size_t roundUp(size_t bytes, size_t multiple)
+    {
+        return (bytes + multiple - 1) / multiple * multiple;
+    }
+
+    uint32_t fnv1a(const void *data, size_t bytes, uint32_t hash = 2166136261u)
+    {
+        const uint8_t *p = (const uint8_t*) data;
+        for (size_t i = 0; i < bytes; ++i) {
+            hash = (hash ^ p[i]) * 16777619u;
+        }
+        return hash;
+    }
+}
+
+struct PersistentHeap::Header
+{
+    uint32_t magic;
+    uint8_t order;
+    uint8_t minOrder;
+    uint16_t unused;
+
+    // redo log of the latest operation
+    uint32_t logCount;
+    uint32_t logChecksum;           // of logCount and the entries, a torn log never matches
+    BuddyEngine::TagWrite log[LogCapacity];
+};
+
+PersistentHeap::PersistentHeap(const std::string &path, uint8_t order) :
+    m_engine(order, MinOrder),
+    m_fd(-1),
+    m_length(0),
+    m_map(nullptr),
+    m_header(nullptr),
+    m_tags(nullptr),
+    m_data(nullptr)
+{
+    static_assert(sizeof(Header) <= 4096, "the redo log has to fit in the first page");
+
+    // [ header + log ][ tags ][ data ], each part starting on a page boundary
+    size_t page = pageSize();
+    size_t units = size_t(1) << (order - MinOrder);
+    size_t tagsOffset = roundUp(sizeof(Header), page);
+    size_t dataOffset = tagsOffset + roundUp(units, page);
+    m_length = dataOffset + (size_t(1) << order);
+
+    m_fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (m_fd < 0) {
+        throw "Unable to open persistent heap";
+    }
+
+    struct stat info;
+    bool existing = fstat(m_fd, &info) == 0 && info.st_size > 0;
+
+    if (existing && size_t(info.st_size) != m_length) {
+        close(m_fd);
+        throw "Persistent heap has a different size";
+    }
+
+    if (!existing && ftruncate(m_fd, m_length) != 0) {
+        close(m_fd);
+        throw "Unable to size persistent heap";
+    }
+
+    m_map = (char*) mmap(nullptr, m_length, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (m_map == MAP_FAILED) {
+        close(m_fd);
+        throw "Unable to map persistent heap";
+    }
+
+    m_header = (Header*) m_map;
+    m_tags = (uint8_t*) (m_map + tagsOffset);
+    m_data = m_map + dataOffset;
+
+    // a file without its magic never finished being created, start it over
+    if (m_header->magic != 0) {
+        if (m_header->magic != Magic || m_header->order != order || m_header->minOrder != MinOrder) {
+            munmap(m_map, m_length);
+            close(m_fd);
+            throw "Not a persistent heap";
+        }
+        recover();
+    } else {
+        // a brand new engine is one free block; the magic goes in last so a half made file is never mistaken for a heap
+        m_tags[0] = m_engine.tags()[0];
+        flush(m_tags, 1);
+
+        m_header->order = order;
+        m_header->minOrder = MinOrder;
+        m_header->magic = Magic;
+        flush(m_header, sizeof(Header));
+    }
+
+    m_engine.recordTagWrites(&m_writes);
+}
+
+PersistentHeap::~PersistentHeap()
+{
+    munmap(m_map, m_length);
+    close(m_fd);
+}
+
+char *PersistentHeap::alloc(uint16_t bytes)
+{
+    if (bytes <= 0) {
+        throw "Har har har";
+    }
+
+    uint8_t k = 0;
+    while ((1u << k) < bytes) {
+        ++k;
+    }
+
+    uint64_t offset = m_engine.alloc(k);
+    if (offset == BuddyEngine::None) {
+        m_writes.clear();
+        throw "Insufficient Memory!";
+    }
+
+    commit();
+    return m_data + offset;
+}
+
+void PersistentHeap::free(char *address)
+{
+    m_engine.free(address - m_data);
+    commit();
+}
+
+void PersistentHeap::commit()
+{
+    if (m_writes.size() > LogCapacity) {
+        throw "Redo log overflow";
+    }
+
+    // 1. make the redo log durable, this is the commit point
+    m_header->logCount = uint32_t(m_writes.size());
+    std::copy(m_writes.begin(), m_writes.end(), m_header->log);
+    m_header->logChecksum = fnv1a(m_header->log, m_writes.size() * sizeof(BuddyEngine::TagWrite),
+                                  fnv1a(&m_header->logCount, sizeof(m_header->logCount)));
+    flush(m_header, sizeof(Header));
+
+    // 2. apply it
+    uint32_t first = m_writes.front().unit, last = first;
+    for (auto && write : m_writes) {
+        m_tags[write.unit] = write.tag;
+        first = std::min(first, write.unit);
+        last = std::max(last, write.unit);
+    }
+    flush(m_tags + first, last - first + 1);
+
+    m_writes.clear();
+}
+
+void PersistentHeap::recover()
+{
+    uint32_t count = m_header->logCount;
+    bool valid = count <= LogCapacity
+            && m_header->logChecksum == fnv1a(m_header->log, count * sizeof(BuddyEngine::TagWrite), fnv1a(&count, sizeof(count)));
+
+    // replaying a log that was already applied changes nothing
+    if (valid) {
+        for (uint32_t i = 0; i < count; ++i) {
+            m_tags[m_header->log[i].unit] = m_header->log[i].tag;
+        }
+        flush(m_tags, size_t(1) << (m_engine.order() - MinOrder));
+    }
+
+    m_engine.restore(m_tags);
+}
+
+void PersistentHeap::flush(const void *address, size_t bytes)
+{
+    // msync wants a page aligned start
+    uintptr_t start = (uintptr_t) address & ~(uintptr_t)(pageSize() - 1);
+    uintptr_t end = (uintptr_t) address + bytes;
+
+    if (msync((void*) start, end - start, MS_SYNC) != 0) {
+        throw "Unable to flush persistent heap";
+    }
+}
+
+void PersistentHeap::print()
+{
+    std::cout << "========= Persistent Heap =======" << std::endl << std::endl;
+    m_engine.forEachBlock([&](uint64_t offset, uint8_t k, bool available) {
+        std::cout << "{ +" << offset << ", " << (1u << k) << (available ? "" : ", RESERVED") << " }" << std::endl;
+    });
+    std::cout << std::endl;
+}
@@ -0,0 +1,57 @@
+#ifndef PERSISTENTHEAP_H
+#define PERSISTENTHEAP_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Allocator.h"
+#include "BuddyEngine.h"
+
+/*
+ * PersistentHeap is a buddy heap kept in a memory mapped file, whose allocation state survives a crash at any point,
+ * including halfway through a split or a coalesce.
+ *
+ * Only the engine's tag bytes are persisted; the free lists are rebuilt from them whenever the file is opened. Each
+ * alloc or free is made atomic with a redo log:
+ * 1. the tag bytes the operation changes are written to the log in the header page, with a checksum, and msync'ed.
+ *    From here on the operation has happened.
+ * 2. the same bytes are written to the tag array, and msync'ed.
+ * A crash during (1) leaves a log that fails its checksum and is ignored, a crash during (2) is repaired by replaying the
+ * log, which is harmless to do twice. The log only ever holds the latest operation, so it never needs clearing.
+ *
+ * Only allocation state is covered, making the contents of the blocks durable is up to the caller.
+ * */
+class PersistentHeap : public Allocator
+{
+public:
+    // opens the heap at path, creating a 2^order byte heap there if there is none
+    PersistentHeap(const std::string &path, uint8_t order);
+    ~PersistentHeap();
+
+    char *alloc(uint16_t bytes) override;
+    void free(char *address) override;
+    void print() override;
+
+    // blocks keep their offset from here across runs, unlike their address
+    char *base() const { return m_data; }
+
+private:
+    struct Header;
+
+    void commit();
+    void recover();
+    void flush(const void *address, size_t bytes);
+
+    BuddyEngine m_engine;
+    std::vector<BuddyEngine::TagWrite> m_writes;
+
+    int m_fd;
+    size_t m_length;
+    char *m_map;
+    Header *m_header;
+    uint8_t *m_tags;
+    char *m_data;
+};
+
+#endif // PERSISTENTHEAP_H
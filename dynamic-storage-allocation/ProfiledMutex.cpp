@@ -0,0 +1,71 @@
+#include "ProfiledMutex.h"
+
+namespace
+{
+    uint64_t nanosBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    }
+}
+
+ProfiledMutex::ProfiledMutex() :
+    m_weight(0),
+    m_acquisitions(0),
+    m_contended(0),
+    m_waitNanos(0),
+    m_holdNanos(0),
+    m_maxHoldNanos(0)
+{
+    for (auto && bucket : m_wait) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void ProfiledMutex::lockContended()
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    m_mutex.lock();
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    uint64_t nanos = nanosBetween(start, now);
+
+    uint8_t bucket = 0;
+    while (bucket < WaitBuckets - 1 && nanos >= (uint64_t(1) << (bucket + 6))) {
+        ++bucket;
+    }
+
+    add(m_contended, 1);
+    add(m_wait[bucket], 1);
+    add(m_waitNanos, nanos);
+    acquired(now, 1);
+}
+
+void ProfiledMutex::timeHold()
+{
+    uint64_t held = nanosBetween(m_acquired, std::chrono::steady_clock::now());
+    add(m_holdNanos, held * m_weight);
+    if (held > m_maxHoldNanos.load(std::memory_order_relaxed)) {
+        m_maxHoldNanos.store(held, std::memory_order_relaxed);
+    }
+    m_weight = 0;
+}
+
+void ProfiledMutex::acquired(std::chrono::steady_clock::time_point now, uint64_t weight)
+{
+    add(m_acquisitions, 1);
+    m_acquired = now;
+    m_weight = weight;
+}
+
+ProfiledMutex::Stats ProfiledMutex::stats() const
+{
+    Stats stats;
+    stats.acquisitions = m_acquisitions.load(std::memory_order_relaxed);
+    stats.contended = m_contended.load(std::memory_order_relaxed);
+    for (int i = 0; i < WaitBuckets; ++i) {
+        stats.wait[i] = m_wait[i].load(std::memory_order_relaxed);
+    }
+    stats.waitNanos = m_waitNanos.load(std::memory_order_relaxed);
+    stats.holdNanos = m_holdNanos.load(std::memory_order_relaxed);
+    stats.maxHoldNanos = m_maxHoldNanos.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,99 @@
+#ifndef PROFILEDMUTEX_H
+#define PROFILEDMUTEX_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+/*
+ * ProfiledMutex is a std::mutex that keeps count of how it is used, to tell when a lock has become a bottleneck and the
+ * heap behind it wants sharding. It works with std::lock_guard and std::unique_lock like any mutex.
+ *
+ * Reading the clock costs several times what an uncontended std::mutex does, so only one uncontended acquisition in
+ * HoldSample has its hold timed, and counts for all of them in holdNanos. Otherwise an uncontended lock is a try_lock
+ * and a counter. A lock that has to wait is always timed, wait and hold alike, as it has lost far more than two clock
+ * reads already. Every counter is written by whoever holds the lock, so plain relaxed stores will do, and stats() can
+ * be read from any thread at any time.
+ * */
+class ProfiledMutex
+{
+public:
+    static const uint8_t WaitBuckets = 12;  // 2^6 ns, 2^7 ns, ..., 2^17 ns and everything slower, as for alloc latency
+    static const uint8_t HoldSample = 64;   // uncontended acquisitions per timed one
+
+    struct Stats
+    {
+        uint64_t acquisitions;
+        uint64_t contended;             // acquisitions that had to wait
+        uint64_t wait[WaitBuckets];     // bucket i counts waits taking less than 2^(i+6) ns, the last one the rest
+        uint64_t waitNanos;             // sum of all waits
+        uint64_t holdNanos;             // sum of the time the lock was held, estimated from the timed acquisitions
+        uint64_t maxHoldNanos;          // longest of the timed ones
+    };
+
+    ProfiledMutex();
+
+    // the untimed paths are inline, so that they cost what the counter does and no call on top
+    void lock()
+    {
+        if (!m_mutex.try_lock()) {
+            lockContended();
+            return;
+        }
+        acquired();
+    }
+
+    bool try_lock()
+    {
+        if (!m_mutex.try_lock()) {
+            return false;
+        }
+        acquired();
+        return true;
+    }
+
+    void unlock()
+    {
+        if (m_weight) {
+            timeHold();
+        }
+        m_mutex.unlock();
+    }
+
+    Stats stats() const;
+
+private:
+    void acquired()
+    {
+        // the first acquisition is always timed, then every HoldSample-th
+        uint64_t acquisitions = m_acquisitions.load(std::memory_order_relaxed);
+        if (acquisitions % HoldSample == 0) {
+            acquired(std::chrono::steady_clock::now(), HoldSample);
+            return;
+        }
+        m_acquisitions.store(acquisitions + 1, std::memory_order_relaxed);
+    }
+
+    void acquired(std::chrono::steady_clock::time_point now, uint64_t weight);
+    void lockContended();
+    void timeHold();
+
+    static void add(std::atomic<uint64_t> &counter, uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    std::mutex m_mutex;
+    std::chrono::steady_clock::time_point m_acquired;
+    uint64_t m_weight;                      // acquisitions the current hold stands for, 0 when it is not timed
+
+    std::atomic<uint64_t> m_acquisitions;
+    std::atomic<uint64_t> m_contended;
+    std::atomic<uint64_t> m_wait[WaitBuckets];
+    std::atomic<uint64_t> m_waitNanos;
+    std::atomic<uint64_t> m_holdNanos;
+    std::atomic<uint64_t> m_maxHoldNanos;
+};
+
+#endif // PROFILEDMUTEX_H
@@ -0,0 +1,238 @@
+#include "PrometheusExporter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <signal.h>
+#include <stdio.h>
+
+namespace
+{
+    // every exporter compares this against the count it last saw, so one SIGUSR1 makes all of them dump
+    std::atomic<uint32_t> signalsReceived(0);
+    static_assert(ATOMIC_INT_LOCK_FREE == 2, "the signal handler needs a lock free counter");
+
+    void requestDump(int)
+    {
+        signalsReceived.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // how often the background thread looks for a pending SIGUSR1
+    const std::chrono::milliseconds signalPoll(100);
+
+    void writeHeader(std::ostream &out, const char *name, const char *type, const char *help)
+    {
+        out << "# HELP " << name << " " << help << "\n";
+        out << "# TYPE " << name << " " << type << "\n";
+    }
+
+    // exact to the nanosecond, where printing nanos * 1e-9 would round to six digits
+    std::string seconds(uint64_t nanos)
+    {
+        char fraction[16];
+        snprintf(fraction, sizeof(fraction), ".%09llu", (unsigned long long)(nanos % 1000000000));
+
+        std::string text = std::to_string(nanos / 1000000000) + fraction;
+        text.erase(text.find_last_not_of('0') + 1);
+        if (text.back() == '.') {
+            text.pop_back();
+        }
+        return text;
+    }
+}
+
+PrometheusExporter::PrometheusExporter(const BuddyAllocator &allocator, const std::string &path) :
+    m_allocator(allocator),
+    m_path(path),
+    m_running(false),
+    m_signalsSeen(0)
+{
+}
+
+PrometheusExporter::~PrometheusExporter()
+{
+    stop();
+}
+
+void PrometheusExporter::addLock(const std::string &name, std::function<ProfiledMutex::Stats()> stats)
+{
+    m_locks.emplace_back(name, stats);
+}
+
+void PrometheusExporter::write(std::ostream &out) const
+{
+    BuddyAllocator::Stats stats = m_allocator.stats();
+
+    writeHeader(out, "buddy_free_blocks", "gauge", "Available blocks of size 2^order.");
+    for (int k = 0; k <= BuddyAllocator::MaxOrder; ++k) {
+        out << "buddy_free_blocks{order=\"" << k << "\"} " << stats.freeBlocks[k] << "\n";
+    }
+
+    writeHeader(out, "buddy_used_blocks", "gauge", "Reserved blocks of size 2^order.");
+    for (int k = 0; k <= BuddyAllocator::MaxOrder; ++k) {
+        out << "buddy_used_blocks{order=\"" << k << "\"} " << stats.usedBlocks[k] << "\n";
+    }
+
+    writeHeader(out, "buddy_live_bytes", "gauge", "Bytes held by reserved blocks.");
+    out << "buddy_live_bytes " << stats.liveBytes << "\n";
+
+    writeHeader(out, "buddy_largest_free_bytes", "gauge", "Size of the largest available block.");
+    out << "buddy_largest_free_bytes " << stats.largestFree << "\n";
+
+    writeHeader(out, "buddy_mapped_bytes", "gauge", "Bytes mapped outside the arena for guarded and direct allocations.");
+    out << "buddy_mapped_bytes " << stats.mappedBytes << "\n";
+
+    writeHeader(out, "buddy_splits_total", "counter", "Blocks split in half to satisfy an allocation.");
+    out << "buddy_splits_total " << stats.splits << "\n";
+
+    writeHeader(out, "buddy_coalesces_total", "counter", "Buddies merged back together on free.");
+    out << "buddy_coalesces_total " << stats.coalesces << "\n";
+
+    writeHeader(out, "buddy_alloc_failures_total", "counter", "Allocations that failed for lack of memory.");
+    out << "buddy_alloc_failures_total " << stats.failures << "\n";
+
+    writeHeader(out, "buddy_alloc_near_misses_total", "counter", "Allocations near a given block that found no room there.");
+    out << "buddy_alloc_near_misses_total " << stats.nearMisses << "\n";
+
+    // prometheus buckets are cumulative, ours are not
+    writeHeader(out, "buddy_alloc_latency_seconds", "histogram", "Time spent in alloc, when latency measurement is on.");
+    uint64_t count = 0;
+    for (int i = 0; i < BuddyAllocator::LatencyBuckets; ++i) {
+        count += stats.latency[i];
+
+        if (i == BuddyAllocator::LatencyBuckets - 1) {
+            out << "buddy_alloc_latency_seconds_bucket{le=\"+Inf\"} " << count << "\n";
+        } else {
+            out << "buddy_alloc_latency_seconds_bucket{le=\"" << seconds(uint64_t(1) << (i + 6)) << "\"} " << count << "\n";
+        }
+    }
+    out << "buddy_alloc_latency_seconds_sum " << seconds(stats.latencyNanos) << "\n";
+    out << "buddy_alloc_latency_seconds_count " << count << "\n";
+
+    if (m_locks.empty()) {
+        return;
+    }
+
+    std::vector<ProfiledMutex::Stats> locks;
+    for (auto && lock : m_locks) {
+        locks.push_back(lock.second());
+    }
+
+    writeHeader(out, "buddy_lock_acquisitions_total", "counter", "Times the lock was taken.");
+    for (size_t i = 0; i < locks.size(); ++i) {
+        out << "buddy_lock_acquisitions_total{lock=\"" << m_locks[i].first << "\"} " << locks[i].acquisitions << "\n";
+    }
+
+    writeHeader(out, "buddy_lock_contended_total", "counter", "Times the lock had to be waited for.");
+    for (size_t i = 0; i < locks.size(); ++i) {
+        out << "buddy_lock_contended_total{lock=\"" << m_locks[i].first << "\"} " << locks[i].contended << "\n";
+    }
+
+    writeHeader(out, "buddy_lock_hold_seconds_total", "counter", "Time the lock was held.");
+    for (size_t i = 0; i < locks.size(); ++i) {
+        out << "buddy_lock_hold_seconds_total{lock=\"" << m_locks[i].first << "\"} " << seconds(locks[i].holdNanos) << "\n";
+    }
+
+    writeHeader(out, "buddy_lock_max_hold_seconds", "gauge", "Longest time the lock was held at once.");
+    for (size_t i = 0; i < locks.size(); ++i) {
+        out << "buddy_lock_max_hold_seconds{lock=\"" << m_locks[i].first << "\"} " << seconds(locks[i].maxHoldNanos) << "\n";
+    }
+
+    writeHeader(out, "buddy_lock_wait_seconds", "histogram", "Time spent waiting for the lock, when it was contended.");
+    for (size_t i = 0; i < locks.size(); ++i) {
+        const std::string &name = m_locks[i].first;
+
+        uint64_t waits = 0;
+        for (int bucket = 0; bucket < ProfiledMutex::WaitBuckets; ++bucket) {
+            waits += locks[i].wait[bucket];
+
+            if (bucket == ProfiledMutex::WaitBuckets - 1) {
+                out << "buddy_lock_wait_seconds_bucket{lock=\"" << name << "\",le=\"+Inf\"} " << waits << "\n";
+            } else {
+                out << "buddy_lock_wait_seconds_bucket{lock=\"" << name << "\",le=\"" << seconds(uint64_t(1) << (bucket + 6)) << "\"} " << waits << "\n";
+            }
+        }
+        out << "buddy_lock_wait_seconds_sum{lock=\"" << name << "\"} " << seconds(locks[i].waitNanos) << "\n";
+        out << "buddy_lock_wait_seconds_count{lock=\"" << name << "\"} " << waits << "\n";
+    }
+}
+
+void PrometheusExporter::dump() const
+{
+    std::string temporary = m_path + ".tmp";
+
+    {
+        std::ofstream out(temporary.c_str(), std::ios::trunc);
+        if (!out) {
+            throw "Unable to write stats file";
+        }
+        write(out);
+    }
+
+    if (rename(temporary.c_str(), m_path.c_str()) != 0) {
+        throw "Unable to write stats file";
+    }
+}
+
+void PrometheusExporter::start(std::chrono::milliseconds interval)
+{
+    stop();
+
+    m_running = true;
+    m_signalsSeen = signalsReceived.load(std::memory_order_relaxed);
+    m_thread = std::thread(&PrometheusExporter::run, this, interval);
+}
+
+void PrometheusExporter::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_wakeup.notify_all();
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void PrometheusExporter::installSignalHandler()
+{
+    struct sigaction action = {};
+    action.sa_handler = requestDump;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, nullptr);
+}
+
+void PrometheusExporter::run(std::chrono::milliseconds interval)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now() + interval;
+
+    while (m_running) {
+        std::chrono::steady_clock::time_point wake = std::min(next, std::chrono::steady_clock::now() + signalPoll);
+        m_wakeup.wait_until(lock, wake);
+
+        if (!m_running) {
+            break;
+        }
+
+        bool due = std::chrono::steady_clock::now() >= next;
+        uint32_t signals = signalsReceived.load(std::memory_order_relaxed);
+        if (!due && signals == m_signalsSeen) {
+            continue;
+        }
+
+        m_signalsSeen = signals;
+        if (due) {
+            next += interval;
+        }
+
+        // a failed dump is retried on the next tick, there is nobody here to report it to
+        try {
+            dump();
+        } catch (const char *) {
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef PROMETHEUSEXPORTER_H
+#define PROMETHEUSEXPORTER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "BuddyAllocator.h"
+#include "ProfiledMutex.h"
+
+/*
+ * PrometheusExporter writes the counters of a BuddyAllocator in the Prometheus text exposition format, ready to be picked
+ * up by the node exporter's textfile collector.
+ *
+ * Everything it reports comes from BuddyAllocator::stats() and ProfiledMutex::stats(), so it never takes a lock the
+ * allocating thread could be waiting on. Files are written next to their destination and renamed into place so a scrape
+ * never sees half a file.
+ * */
+class PrometheusExporter
+{
+public:
+    PrometheusExporter(const BuddyAllocator &allocator, const std::string &path);
+    ~PrometheusExporter();
+
+    // also report a lock, as buddy_lock_*{lock="name"}. Only before start()
+    void addLock(const std::string &name, std::function<ProfiledMutex::Stats()> stats);
+
+    void write(std::ostream &out) const;
+    void dump() const;
+
+    // dump every interval, and whenever SIGUSR1 arrives (see installSignalHandler)
+    void start(std::chrono::milliseconds interval);
+    void stop();
+
+    static void installSignalHandler();
+
+private:
+    void run(std::chrono::milliseconds interval);
+
+    const BuddyAllocator &m_allocator;
+    std::string m_path;
+    std::vector<std::pair<std::string, std::function<ProfiledMutex::Stats()>>> m_locks;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    bool m_running;
+    uint32_t m_signalsSeen;         // SIGUSR1s already answered with a dump, only touched by the thread
+};
+
+#endif // PROMETHEUSEXPORTER_H
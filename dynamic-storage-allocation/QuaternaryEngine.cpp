@@ -0,0 +1,203 @@
+#include "QuaternaryEngine.h"
+#include "AllocatorHooks.h"
+
+#include <iostream>
+
+/*
+ * Same rules as the binary buddy system, with four buddies instead of two:
+ * - blocks of size 2^k such that minOrder <= k <= order and order - k is even
+ * - blocks are allocated by splitting larger blocks into quarters
+ * - blocks are reclaimed once all four quarters of the block they were split from are free again
+ * */
+
+const uint64_t QuaternaryEngine::None;
+const uint8_t QuaternaryEngine::Interior;
+
+QuaternaryEngine::QuaternaryEngine(uint8_t order, uint8_t minOrder) :
+    m_order(order),
+    m_minOrder(minOrder),
+    m_units(uint64_t(1) << (order - minOrder)),
+    m_quarterBase(),
+    m_nonEmpty(0),
+    m_freeCount(),
+    m_splits(0),
+    m_coalesces(0),
+    m_details(false)
+{
+    if (minOrder > order || ((order - minOrder) & 1) || order - minOrder > 30 || order > 63) {
+        throw "Invalid order";
+    }
+
+    m_tag.resize(m_units, Interior);
+    m_linkf.resize(m_units + order + 1);
+    m_linkb.resize(m_units + order + 1);
+
+    for (int k = 0; k <= order; ++k) {
+        m_linkf[head(k)] = m_linkb[head(k)] = head(k);
+    }
+
+    uint64_t masks = 0;
+    for (int k = minOrder; k < order; k += 2) {
+        m_quarterBase[k] = masks;
+        masks += m_units >> (k + 2 - minOrder);
+    }
+    m_quarters.resize((masks + 1) / 2);
+
+    m_tag[0] = Available | order;
+    push(0, order);
+}
+
+uint8_t QuaternaryEngine::orderFor(uint8_t k) const
+{
+    if (k < m_minOrder) {
+        return m_minOrder;
+    }
+    return k + ((m_order - k) & 1);
+}
+
+uint64_t QuaternaryEngine::alloc(uint8_t k)
+{
+    if (k > m_order) {
+        return None;
+    }
+
+    k = orderFor(k);
+
+    // find smallest available block that is sufficient for the request
+    uint64_t candidates = m_nonEmpty >> k;
+    if (candidates == 0) {
+        if (m_details) {
+            std::cout << "   No blocks of size >= " << (uint64_t(1) << k) << " available." << std::endl;
+        }
+        return None;
+    }
+
+    uint8_t j = k + __builtin_ctzll(candidates);
+    uint32_t unit = m_linkf[head(j)];
+    remove(unit, j);
+
+    if (m_details) {
+        std::cout << "   Found available block: Block( " << (uint64_t(unit) << m_minOrder) << ", " << (uint64_t(1) << j) << " )" << std::endl;
+    }
+
+    // split off quarters until the first one is the right size, the other three are free
+    while (j != k) {
+        j -= 2;
+
+        uint32_t quarter = uint32_t(1) << (j - m_minOrder);
+        for (uint32_t i = 1; i < 4; ++i) {
+            setTag(unit + i * quarter, Available | j);
+            push(unit + i * quarter, j);
+        }
+        ++m_splits;
+        ALLOCATOR_HOOK(onQuarterSplit, this, uint64_t(unit) << m_minOrder, j);
+
+        if (m_details) {
+            std::cout << "      Split required - Creating smaller blocks: Block( " << (uint64_t(unit + quarter) << m_minOrder) << ", " << (uint64_t(1) << j) << " ) x 3" << std::endl;
+        }
+    }
+
+    setTag(unit, k);
+    return uint64_t(unit) << m_minOrder;
+}
+
+uint8_t QuaternaryEngine::free(uint64_t offset)
+{
+    if ((offset >> m_order) || (offset & ((uint64_t(1) << m_minOrder) - 1))) {
+        throw "Block is out of range";
+    }
+
+    uint32_t unit = uint32_t(offset >> m_minOrder);
+
+    if ((m_tag[unit] & Available) || m_tag[unit] == Interior) {
+        throw "Block is not reserved";
+    }
+
+    uint8_t k = m_tag[unit] & KVal;
+    uint8_t released = k;
+
+    // merge as long as the other three quarters are free too
+    while (k != m_order) {
+        if ((freeQuarters(unit, k) | quarterBit(unit, k)) != 0xf) {
+            break;
+        }
+
+        uint32_t quarter = uint32_t(1) << (k - m_minOrder);
+        uint32_t first = unit & ~(4 * quarter - 1);
+        for (uint32_t i = 0; i < 4; ++i) {
+            if (first + i * quarter != unit) {
+                remove(first + i * quarter, k);
+            }
+            // only the first quarter still starts a block, the others must not be freed again on the strength of a stale tag
+            if (i != 0) {
+                setTag(first + i * quarter, Interior);
+            }
+        }
+        ++m_coalesces;
+        ALLOCATOR_HOOK(onQuarterCoalesce, this, uint64_t(first) << m_minOrder, k);
+
+        if (m_details) {
+            std::cout << "      Coalescing - Reclaiming quarters of: Block( " << (uint64_t(first) << m_minOrder) << ", " << (uint64_t(1) << (k + 2)) << " )" << std::endl;
+        }
+
+        unit = first;
+        k += 2;
+    }
+
+    setTag(unit, Available | k);
+    push(unit, k);
+
+    if (m_details) {
+        std::cout << "   Free Success - New block available: Block( " << (uint64_t(unit) << m_minOrder) << ", " << (uint64_t(1) << k) << " )" << std::endl;
+    }
+
+    return released;
+}
+
+int QuaternaryEngine::largestFree() const
+{
+    return m_nonEmpty ? 63 - __builtin_clzll(m_nonEmpty) : -1;
+}
+
+uint8_t QuaternaryEngine::freeQuarters(uint32_t unit, uint8_t k) const
+{
+    uint64_t index = quarterIndex(unit, k);
+    return (m_quarters[index >> 1] >> ((index & 1) * 4)) & 0xf;
+}
+
+void QuaternaryEngine::setFreeQuarters(uint32_t unit, uint8_t k, uint8_t mask)
+{
+    uint64_t index = quarterIndex(unit, k);
+    uint8_t shift = (index & 1) * 4;
+    m_quarters[index >> 1] = uint8_t((m_quarters[index >> 1] & ~(0xf << shift)) | (mask << shift));
+}
+
+void QuaternaryEngine::push(uint32_t unit, uint8_t k)
+{
+    uint32_t front = m_linkf[head(k)];
+    m_linkf[unit] = front;
+    m_linkb[unit] = head(k);
+    m_linkb[front] = unit;
+    m_linkf[head(k)] = unit;
+
+    ++m_freeCount[k];
+    m_nonEmpty |= uint64_t(1) << k;
+
+    if (k != m_order) {
+        setFreeQuarters(unit, k, freeQuarters(unit, k) | quarterBit(unit, k));
+    }
+}
+
+void QuaternaryEngine::remove(uint32_t unit, uint8_t k)
+{
+    m_linkf[m_linkb[unit]] = m_linkf[unit];
+    m_linkb[m_linkf[unit]] = m_linkb[unit];
+
+    if (--m_freeCount[k] == 0) {
+        m_nonEmpty &= ~(uint64_t(1) << k);
+    }
+
+    if (k != m_order) {
+        setFreeQuarters(unit, k, freeQuarters(unit, k) & ~quarterBit(unit, k));
+    }
+}
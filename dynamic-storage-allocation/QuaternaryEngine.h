@@ -0,0 +1,96 @@
+#ifndef QUATERNARYENGINE_H
+#define QUATERNARYENGINE_H
+
+#include <stdint.h>
+#include <vector>
+
+/*
+ * QuaternaryEngine is BuddyEngine with blocks split four ways instead of two: a block of 2^k splits into four quarters
+ * of 2^(k-2), and only comes back together once all four are free. The tree is half as deep, so a small block out of a
+ * large range costs half as many splits, and freeing it half as many merges.
+ *
+ * The price is coarser sizes. Only every other order exists (those an even number of orders below the whole range), so a
+ * request between two of them is rounded up to the larger one, wasting up to three quarters of the block instead of half.
+ *
+ * Tags and free lists are kept beside the range as in BuddyEngine. On top of that every block that has been split keeps a
+ * 4 bit mask of which of its quarters are free, so a merge is decided by a single look rather than by visiting three
+ * siblings.
+ * */
+class QuaternaryEngine
+{
+public:
+    static const uint64_t None = ~uint64_t(0);
+
+    // order - minOrder has to be even
+    QuaternaryEngine(uint8_t order, uint8_t minOrder = 0);
+
+    // offset of a block of at least 2^k, or None if there is no room
+    uint64_t alloc(uint8_t k);
+
+    // returns the order of the block that was released
+    uint8_t free(uint64_t offset);
+
+    uint8_t order() const { return m_order; }
+    uint8_t minOrder() const { return m_minOrder; }
+
+    // the order of the block a request for 2^k ends up in
+    uint8_t orderFor(uint8_t k) const;
+
+    // offset must be the start of a block, free or reserved
+    uint8_t orderOf(uint64_t offset) const { return m_tag[offset >> m_minOrder] & KVal; }
+    bool isFree(uint64_t offset) const { return m_tag[offset >> m_minOrder] & Available; }
+
+    uint64_t freeBlocks(uint8_t k) const { return m_freeCount[k]; }
+    int largestFree() const;        // order of the largest free block, -1 when there is none
+    uint64_t splits() const { return m_splits; }
+    uint64_t coalesces() const { return m_coalesces; }
+
+    void showDetails(bool show) { m_details = show; }
+
+    // calls visit(offset, k, available) for every block in address order
+    template <typename Visit>
+    void forEachBlock(Visit visit) const
+    {
+        for (uint64_t unit = 0; unit < m_units; unit += uint64_t(1) << ((m_tag[unit] & KVal) - m_minOrder)) {
+            visit(unit << m_minOrder, uint8_t(m_tag[unit] & KVal), bool(m_tag[unit] & Available));
+        }
+    }
+
+private:
+    static const uint8_t Available = 0x80;
+    static const uint8_t KVal = 0x7f;
+    static const uint8_t Interior = KVal;    // any unit not starting a block, see BuddyEngine
+
+    uint32_t head(uint8_t k) const { return uint32_t(m_units) + k; }
+
+    // the quarter mask of the block that (unit, k) is a quarter of, see m_quarters
+    uint64_t quarterIndex(uint32_t unit, uint8_t k) const { return m_quarterBase[k] + (unit >> (k + 2 - m_minOrder)); }
+    uint8_t quarterBit(uint32_t unit, uint8_t k) const { return uint8_t(1) << ((unit >> (k - m_minOrder)) & 3); }
+    uint8_t freeQuarters(uint32_t unit, uint8_t k) const;
+    void setFreeQuarters(uint32_t unit, uint8_t k, uint8_t mask);
+
+    void setTag(uint32_t unit, uint8_t tag) { m_tag[unit] = tag; }
+    void push(uint32_t unit, uint8_t k);
+    void remove(uint32_t unit, uint8_t k);
+
+    uint8_t m_order;
+    uint8_t m_minOrder;
+    uint64_t m_units;
+
+    std::vector<uint8_t> m_tag;
+    std::vector<uint32_t> m_linkf, m_linkb;
+
+    // two 4 bit masks to a byte, one for every block that could be split, kept up to date by push and remove. The masks
+    // of blocks split into quarters of 2^k start at m_quarterBase[k]
+    std::vector<uint8_t> m_quarters;
+    uint64_t m_quarterBase[64];
+
+    uint64_t m_nonEmpty;            // bit k is set while the list of free 2^k blocks has something in it
+    uint64_t m_freeCount[64];
+    uint64_t m_splits;
+    uint64_t m_coalesces;
+
+    bool m_details;
+};
+
+#endif // QUATERNARYENGINE_H
@@ -0,0 +1,98 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+/*
+ * SeqLock publishes a small, trivially copyable value from a single writer to any number of readers. Readers never block
+ * the writer and the writer never waits for readers: a reader simply retries its copy if the sequence number changed
+ * (or was odd, meaning a store was in progress) while it was reading.
+ *
+ * The value is kept as an array of relaxed atomic words so that a torn read is merely discarded rather than being a data race.
+ * The whole thing is cache line aligned so the writer's hot allocation state never shares a line with it.
+ * */
+template <typename T>
+class alignas(64) SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock can only publish trivially copyable values");
+
+public:
+    SeqLock() : m_sequence(0)
+    {
+        for (auto && word : m_words) {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // must only ever be called from one thread at a time
+    void store(const T &value)
+    {
+        uint64_t words[Words] = {};
+        memcpy(words, &value, sizeof(T));
+
+        uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < Words; ++i) {
+            m_words[i].store(words[i], std::memory_order_relaxed);
+        }
+
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    /*
+     * Like store, but only writes the words of value whose bit is set in words (word i holding bytes [8i, 8i + 8)), for a
+     * writer that keeps track of what it changed in a large value and would rather not copy the rest every time.
+     * */
+    void store(const T &value, uint64_t words)
+    {
+        static_assert(Words <= 64, "the words of a value this large cannot all be picked out");
+        const char *bytes = reinterpret_cast<const char*>(&value);
+
+        uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (words &= Words == 64 ? ~uint64_t(0) : (uint64_t(1) << (Words % 64)) - 1; words; words &= words - 1) {
+            size_t i = __builtin_ctzll(words);
+            uint64_t word = 0;
+            memcpy(&word, bytes + i * sizeof(uint64_t), i + 1 < Words ? sizeof(uint64_t) : sizeof(T) - i * sizeof(uint64_t));
+            m_words[i].store(word, std::memory_order_relaxed);
+        }
+
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    T load() const
+    {
+        uint64_t words[Words];
+        uint32_t before, after;
+
+        do {
+            before = m_sequence.load(std::memory_order_acquire);
+
+            for (size_t i = 0; i < Words; ++i) {
+                words[i] = m_words[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = m_sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        T value;
+        memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+private:
+    static const size_t Words = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint32_t> m_sequence;
+    std::atomic<uint64_t> m_words[Words];
+};
+
+#endif // SEQLOCK_H
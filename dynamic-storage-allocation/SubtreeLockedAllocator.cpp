@@ -0,0 +1,213 @@
+#include "SubtreeLockedAllocator.h"
+#include "BuddyAllocator.h"
+
+#include <functional>
+#include <new>
+#include <iostream>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include <xmmintrin.h>
+
+namespace
+{
+    // same smallest block as BuddyAllocator
+    const uint8_t MinOrder = 3;
+
+    uint8_t partitionOrderFor(uint16_t m, uint8_t partitionOrder)
+    {
+        if (m > BuddyAllocator::MaxOrder || m < MinOrder) {
+            throw "Insufficient Memory";
+        }
+
+        if (partitionOrder == 0) {
+            partitionOrder = m >= MinOrder + 3 ? m - 3 : m;
+        }
+        if (partitionOrder < MinOrder || partitionOrder > m) {
+            throw "Invalid order";
+        }
+        return partitionOrder;
+    }
+}
+
+SubtreeLockedAllocator::SubtreeLockedAllocator(uint16_t m, uint8_t partitionOrder) :
+    m_order(m),
+    m_partitionOrder(partitionOrderFor(m, partitionOrder)),
+    m_subtreeCount(1u << (m - m_partitionOrder)),
+    m_buff(nullptr),
+    m_subtrees(nullptr),
+    m_global(m, m_partitionOrder),
+    m_spills(0),
+    m_globalSteps(0)
+{
+    m_buff = (char*) _mm_malloc(1 << m, 1 << m);
+    memset(m_buff, 0, 1 << m);
+
+    // new only promises alignas(64) from C++17 on
+    m_subtrees = (Subtree*) _mm_malloc(m_subtreeCount * sizeof(Subtree), alignof(Subtree));
+    for (uint32_t subtree = 0; subtree < m_subtreeCount; ++subtree) {
+        new (&m_subtrees[subtree]) Subtree();
+    }
+}
+
+SubtreeLockedAllocator::~SubtreeLockedAllocator()
+{
+    for (uint32_t subtree = 0; subtree < m_subtreeCount; ++subtree) {
+        m_subtrees[subtree].~Subtree();
+    }
+    _mm_free(m_subtrees);
+    _mm_free(m_buff);
+}
+
+uint32_t SubtreeLockedAllocator::home() const
+{
+    static thread_local size_t hash = std::hash<std::thread::id>()(std::this_thread::get_id());
+    return uint32_t(hash & (m_subtreeCount - 1));
+}
+
+char *SubtreeLockedAllocator::alloc(uint16_t bytes)
+{
+    if (bytes <= 0) {
+        throw "Har har har";
+    }
+
+    if (bytes > (1u << m_order)) {
+        throw "Insufficient Memory!";
+    }
+
+    uint8_t k = BuddyAllocator::orderFor(bytes);
+
+    uint64_t offset;
+    if (k >= m_partitionOrder) {
+        offset = allocGlobal(k);
+    } else {
+        // our own subtree first, then the others in turn
+        uint32_t first = home();
+        offset = allocIn(first, k);
+
+        for (uint32_t i = 1; offset == BuddyEngine::None && i < m_subtreeCount; ++i) {
+            offset = allocIn((first + i) & (m_subtreeCount - 1), k);
+        }
+
+        if (offset != BuddyEngine::None && offset >> m_partitionOrder != first) {
+            ++m_spills;
+        }
+    }
+
+    if (offset == BuddyEngine::None) {
+        throw "Insufficient Memory!";
+    }
+
+    return m_buff + offset;
+}
+
+uint64_t SubtreeLockedAllocator::allocIn(uint32_t subtree, uint8_t k)
+{
+    Subtree &tree = m_subtrees[subtree];
+    std::lock_guard<ProfiledMutex> lock(tree.mutex);
+
+    if (!tree.engine) {
+        // borrow the subtree, if nobody has it as part of a larger block
+        {
+            std::lock_guard<ProfiledMutex> global(m_globalMutex);
+            ++m_globalSteps;
+            if (!m_global.allocAt(uint64_t(subtree) << m_partitionOrder, m_partitionOrder)) {
+                return BuddyEngine::None;
+            }
+        }
+        tree.engine.reset(new BuddyEngine(m_partitionOrder, MinOrder));
+    }
+
+    uint64_t offset = tree.engine->alloc(k);
+    if (offset == BuddyEngine::None) {
+        return BuddyEngine::None;
+    }
+    return (uint64_t(subtree) << m_partitionOrder) + offset;
+}
+
+uint64_t SubtreeLockedAllocator::allocGlobal(uint8_t k)
+{
+    std::lock_guard<ProfiledMutex> global(m_globalMutex);
+    ++m_globalSteps;
+
+    uint64_t offset = m_global.alloc(k);
+    if (offset != BuddyEngine::None) {
+        return offset;
+    }
+
+    // take back every borrowed subtree that is empty again, so it can merge with its neighbours. Waiting for a subtree
+    // lock here would deadlock with a thread in allocIn, so busy subtrees are skipped
+    bool returned = false;
+    for (uint32_t subtree = 0; subtree < m_subtreeCount; ++subtree) {
+        Subtree &tree = m_subtrees[subtree];
+        std::unique_lock<ProfiledMutex> lock(tree.mutex, std::try_to_lock);
+
+        if (lock && tree.engine && tree.engine->largestFree() == m_partitionOrder) {
+            tree.engine.reset();
+            m_global.free(uint64_t(subtree) << m_partitionOrder);
+            returned = true;
+        }
+    }
+
+    return returned ? m_global.alloc(k) : BuddyEngine::None;
+}
+
+void SubtreeLockedAllocator::free(char *address)
+{
+    if (address < m_buff || address >= m_buff + (1u << m_order)) {
+        throw "Not allocated by this allocator";
+    }
+
+    uint64_t offset = address - m_buff;
+    Subtree &tree = m_subtrees[offset >> m_partitionOrder];
+
+    std::lock_guard<ProfiledMutex> lock(tree.mutex);
+
+    // a subtree that is not borrowed can only be part of a block from the global engine
+    if (tree.engine) {
+        tree.engine->free(offset & ((uint64_t(1) << m_partitionOrder) - 1));
+    } else {
+        std::lock_guard<ProfiledMutex> global(m_globalMutex);
+        ++m_globalSteps;
+        m_global.free(offset);
+    }
+}
+
+void SubtreeLockedAllocator::print()
+{
+    std::cout << "========= Subtrees =======" << std::endl << std::endl;
+
+    std::vector<bool> borrowed(m_subtreeCount);
+
+    for (uint32_t subtree = 0; subtree < m_subtreeCount; ++subtree) {
+        Subtree &tree = m_subtrees[subtree];
+        std::lock_guard<ProfiledMutex> lock(tree.mutex);
+
+        std::cout << "{ Subtree( " << (void*)(m_buff + (uint64_t(subtree) << m_partitionOrder)) << ", ";
+        if (!tree.engine) {
+            std::cout << "not borrowed ) }" << std::endl;
+            continue;
+        }
+
+        borrowed[subtree] = true;
+
+        size_t used = 0;
+        tree.engine->forEachBlock([&](uint64_t, uint8_t k, bool available) {
+            used += available ? 0 : size_t(1) << k;
+        });
+        std::cout << used << " bytes used ) }" << std::endl;
+    }
+
+    {
+        std::lock_guard<ProfiledMutex> global(m_globalMutex);
+        m_global.forEachBlock([&](uint64_t offset, uint8_t k, bool available) {
+            // the rest are subtrees, listed above
+            if (!available && !borrowed[offset >> m_partitionOrder]) {
+                std::cout << "{ Global( " << (void*)(m_buff + offset) << ", " << (1u << k) << " ) }" << std::endl;
+            }
+        });
+    }
+
+    Counters counters = this->counters();
+    std::cout << "spills " << counters.spills << ", global steps " << counters.globalSteps << std::endl << std::endl;
+}
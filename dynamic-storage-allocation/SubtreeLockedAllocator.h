@@ -0,0 +1,75 @@
+#ifndef SUBTREELOCKEDALLOCATOR_H
+#define SUBTREELOCKEDALLOCATOR_H
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include "Allocator.h"
+#include "BuddyEngine.h"
+#include "ProfiledMutex.h"
+
+/*
+ * SubtreeLockedAllocator is a thread safe buddy heap of 2^m bytes that does not serialise everything on one lock. The
+ * arena is cut into subtrees of 2^partitionOrder bytes, each one a buddy system of its own behind its own mutex, so two
+ * threads working in different subtrees never wait for each other.
+ *
+ * Above the partition order a global engine hands whole subtrees out and takes them back, behind a global mutex:
+ * - a small request goes to the subtree picked by the calling thread, which borrows a subtree from the global engine if
+ *   it has none yet, and tries the others when it is full
+ * - a request of a whole subtree or more goes straight to the global engine. When that comes up empty, subtrees whose
+ *   blocks have all been freed are handed back first, merging them into larger blocks again.
+ *
+ * Locks are only ever taken subtree first, then global; the global step merely tries subtree locks it does not hold.
+ * */
+class SubtreeLockedAllocator : public Allocator
+{
+public:
+    struct Counters
+    {
+        uint64_t spills;            // small allocations the thread's own subtree could not take
+        uint64_t globalSteps;       // times the global lock was taken
+    };
+
+    // partitionOrder of 0 makes eight subtrees
+    SubtreeLockedAllocator(uint16_t m, uint8_t partitionOrder = 0);
+    ~SubtreeLockedAllocator();
+
+    char *alloc(uint16_t bytes) override;
+    void free(char *address) override;
+    void print() override;
+
+    Counters counters() const { return Counters{ m_spills.load(), m_globalSteps.load() }; }
+
+    // per subtree and for the global step, to tell whether more subtrees would help
+    size_t subtrees() const { return m_subtreeCount; }
+    ProfiledMutex::Stats lockStats(uint32_t subtree) const { return m_subtrees[subtree].mutex.stats(); }
+    ProfiledMutex::Stats globalLockStats() const { return m_globalMutex.stats(); }
+
+private:
+    struct alignas(64) Subtree
+    {
+        ProfiledMutex mutex;
+        std::unique_ptr<BuddyEngine> engine;    // only while the subtree is borrowed from m_global
+    };
+
+    uint64_t allocIn(uint32_t subtree, uint8_t k);
+    uint64_t allocGlobal(uint8_t k);
+    uint32_t home() const;
+
+    uint8_t m_order;
+    uint8_t m_partitionOrder;
+    uint32_t m_subtreeCount;
+    char *m_buff;
+
+    Subtree *m_subtrees;            // cache line aligned, so neighbouring locks do not share a line
+
+    ProfiledMutex m_globalMutex;
+    BuddyEngine m_global;           // in units of whole subtrees
+
+    std::atomic<uint64_t> m_spills;
+    std::atomic<uint64_t> m_globalSteps;
+};
+
+#endif // SUBTREELOCKEDALLOCATOR_H
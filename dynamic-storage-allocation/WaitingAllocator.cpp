@@ -0,0 +1,147 @@
+#include "WaitingAllocator.h"
+
+#include <algorithm>
+#include <vector>
+
+WaitingAllocator::WaitingAllocator(BuddyAllocator &allocator) :
+    m_allocator(allocator)
+{
+}
+
+char *WaitingAllocator::alloc(uint16_t bytes)
+{
+    return allocUntil(bytes, nullptr);
+}
+
+char *WaitingAllocator::allocFor(uint16_t bytes, std::chrono::milliseconds timeout)
+{
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+    return allocUntil(bytes, &deadline);
+}
+
+char *WaitingAllocator::allocUntil(uint16_t bytes, const std::chrono::steady_clock::time_point *deadline)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (char *address = tryAlloc(bytes)) {
+        return address;
+    }
+
+    std::condition_variable wakeup;
+    Waiter waiter = {};
+    waiter.bytes = bytes;
+    waiter.wakeup = &wakeup;
+    m_waiters.push_back(&waiter);
+
+    auto served = [&] { return waiter.address != nullptr; };
+    if (deadline) {
+        wakeup.wait_until(lock, *deadline, served);
+    } else {
+        wakeup.wait(lock, served);
+    }
+
+    if (!waiter.address) {
+        // gave up. If we were at the front, whoever is behind us may well fit now
+        bool front = m_waiters.front() == &waiter;
+        m_waiters.erase(std::find(m_waiters.begin(), m_waiters.end(), &waiter));
+        if (front) {
+            serve(lock);
+        }
+    }
+
+    return waiter.address;
+}
+
+void WaitingAllocator::free(char *address)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_allocator.free(address);
+    serve(lock);
+}
+
+void WaitingAllocator::print()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_allocator.print();
+}
+
+char *WaitingAllocator::tryAlloc(uint16_t bytes)
+{
+    // what could never be served must not join the queue, where it would hold up everyone behind it
+    if (bytes <= 0) {
+        throw "Har har har";
+    }
+    if (bytes > m_allocator.capacity()) {
+        throw "Insufficient Memory";
+    }
+
+    // nobody gets to skip the queue
+    if (!m_waiters.empty()) {
+        return nullptr;
+    }
+
+    return m_allocator.tryAlloc(bytes);
+}
+
+void WaitingAllocator::serve(std::unique_lock<std::mutex> &lock)
+{
+#ifdef WAITINGALLOCATOR_COROUTINES
+    std::vector<std::coroutine_handle<>> ready;
+#endif
+
+    // strictly in order: once the front waiter doesn't fit, everyone behind it keeps waiting too
+    while (!m_waiters.empty()) {
+        Waiter *waiter = m_waiters.front();
+
+        waiter->address = m_allocator.tryAlloc(waiter->bytes);
+        if (!waiter->address) {
+            break;
+        }
+
+        m_waiters.pop_front();
+
+        if (waiter->wakeup) {
+            waiter->wakeup->notify_one();
+        }
+#ifdef WAITINGALLOCATOR_COROUTINES
+        else {
+            ready.push_back(waiter->handle);
+        }
+#endif
+    }
+
+#ifdef WAITINGALLOCATOR_COROUTINES
+    // coroutines may well call free themselves, so they run without our lock
+    if (!ready.empty()) {
+        lock.unlock();
+        for (auto && handle : ready) {
+            handle.resume();
+        }
+        lock.lock();
+    }
+#else
+    (void) lock;
+#endif
+}
+
+#ifdef WAITINGALLOCATOR_COROUTINES
+WaitingAllocator::Awaiter WaitingAllocator::allocAsync(uint16_t bytes)
+{
+    return Awaiter(*this, bytes);
+}
+
+bool WaitingAllocator::Awaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    std::lock_guard<std::mutex> lock(m_allocator.m_mutex);
+
+    // no need to suspend at all if there is room right now
+    m_waiter.address = m_allocator.tryAlloc(m_waiter.bytes);
+    if (m_waiter.address) {
+        return false;
+    }
+
+    m_waiter.handle = handle;
+    m_allocator.m_waiters.push_back(&m_waiter);
+    return true;
+}
+#endif
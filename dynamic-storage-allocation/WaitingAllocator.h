@@ -0,0 +1,83 @@
+#ifndef WAITINGALLOCATOR_H
+#define WAITINGALLOCATOR_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#  if __has_include(<coroutine>)
+#    include <coroutine>
+#    define WAITINGALLOCATOR_COROUTINES 1
+#  endif
+#endif
+
+#include "Allocator.h"
+#include "BuddyAllocator.h"
+
+/*
+ * WaitingAllocator puts backpressure on callers instead of failing them: when the heap is full, an allocation waits
+ * until enough memory is freed to satisfy it. Waiters are served strictly in arrival order, and a newcomer never
+ * overtakes someone already waiting, even if its smaller request would fit.
+ *
+ * All calls are thread safe. The wrapped allocator must not be used directly while a WaitingAllocator owns it.
+ * */
+class WaitingAllocator : public Allocator
+{
+public:
+    explicit WaitingAllocator(BuddyAllocator &allocator);
+
+    // waits as long as it takes
+    char *alloc(uint16_t bytes) override;
+
+    // nullptr if nothing could be had in time
+    char *allocFor(uint16_t bytes, std::chrono::milliseconds timeout);
+
+    void free(char *address) override;
+    void print() override;
+
+private:
+    struct Waiter
+    {
+        uint16_t bytes;
+        char *address;                      // set by whoever served the request
+        std::condition_variable *wakeup;    // blocking waiters
+#ifdef WAITINGALLOCATOR_COROUTINES
+        std::coroutine_handle<> handle;     // suspended coroutines
+#endif
+    };
+
+    char *allocUntil(uint16_t bytes, const std::chrono::steady_clock::time_point *deadline);
+    char *tryAlloc(uint16_t bytes);
+    void serve(std::unique_lock<std::mutex> &lock);
+
+    BuddyAllocator &m_allocator;
+    std::mutex m_mutex;
+    std::deque<Waiter*> m_waiters;
+
+#ifdef WAITINGALLOCATOR_COROUTINES
+public:
+    /*
+     * co_await allocAsync(bytes) suspends the coroutine until its request can be met. It is resumed on the thread whose
+     * free made room.
+     * */
+    class Awaiter
+    {
+    public:
+        Awaiter(WaitingAllocator &allocator, uint16_t bytes) : m_allocator(allocator), m_waiter{ bytes, nullptr, nullptr, {} } {}
+
+        bool await_ready() const { return false; }
+        bool await_suspend(std::coroutine_handle<> handle);
+        char *await_resume() const { return m_waiter.address; }
+
+    private:
+        WaitingAllocator &m_allocator;
+        Waiter m_waiter;
+    };
+
+    Awaiter allocAsync(uint16_t bytes);
+#endif
+};
+
+#endif // WAITINGALLOCATOR_H
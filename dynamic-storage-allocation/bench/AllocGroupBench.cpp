@@ -0,0 +1,93 @@
+#include "BuddyAllocator.h"
+
+#include <benchmark/benchmark.h>
+
+namespace
+{
+    struct Xorshift
+    {
+        uint64_t state = 88172645463325252ull;
+
+        uint64_t operator()()
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return state;
+        }
+    };
+
+    const size_t LiveRecords = 64;
+
+    // a 32 byte header and three arrays of 8 to 128 bytes, as in the records this is meant for
+    void recordSizes(Xorshift &random, uint16_t *sizes)
+    {
+        sizes[0] = 32;
+        for (int i = 1; i < 4; ++i) {
+            sizes[i] = uint16_t(8 << (random() % 5));
+        }
+    }
+
+    // every iteration tears down the oldest of 64 live records and builds a new one, with one allocGroup
+    void BM_RecordGroup(benchmark::State &state)
+    {
+        BuddyAllocator heap(16);
+        char *records[LiveRecords] = {};
+        Xorshift random;
+        size_t oldest = 0;
+
+        for (auto _ : state) {
+            if (records[oldest]) {
+                heap.free(records[oldest]);
+            }
+
+            uint16_t sizes[4];
+            char *parts[4];
+            recordSizes(random, sizes);
+            records[oldest] = heap.allocGroup(sizes, nullptr, 4, parts);
+            benchmark::DoNotOptimize(parts);
+            oldest = (oldest + 1) % LiveRecords;
+        }
+
+        for (char *record : records) {
+            if (record) {
+                heap.free(record);
+            }
+        }
+    }
+    BENCHMARK(BM_RecordGroup);
+
+    // the same records with an alloc and a free per part
+    void BM_RecordPerPart(benchmark::State &state)
+    {
+        BuddyAllocator heap(16);
+        char *records[LiveRecords][4] = {};
+        Xorshift random;
+        size_t oldest = 0;
+
+        for (auto _ : state) {
+            for (char *&part : records[oldest]) {
+                if (part) {
+                    heap.free(part);
+                }
+            }
+
+            uint16_t sizes[4];
+            recordSizes(random, sizes);
+            for (int i = 0; i < 4; ++i) {
+                records[oldest][i] = heap.alloc(sizes[i]);
+            }
+            benchmark::DoNotOptimize(records[oldest]);
+            oldest = (oldest + 1) % LiveRecords;
+        }
+
+        for (auto &record : records) {
+            for (char *part : record) {
+                if (part) {
+                    heap.free(part);
+                }
+            }
+        }
+    }
+    BENCHMARK(BM_RecordPerPart);
+}
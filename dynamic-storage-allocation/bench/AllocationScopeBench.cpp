@@ -0,0 +1,99 @@
+#include "AllocationScope.h"
+#include "BuddyAllocator.h"
+
+#include <benchmark/benchmark.h>
+
+#include <new>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+    // a structure of range(0) nodes of 16 to 128 bytes, built in a random order of sizes
+    std::vector<uint16_t> nodeSizes(size_t count)
+    {
+        std::mt19937 random(7);
+        std::vector<uint16_t> sizes(count);
+        for (auto && size : sizes) {
+            size = uint16_t(16 << (random() % 4));
+        }
+        return sizes;
+    }
+
+    // tearing down what was built, one free per node in the order they were allocated
+    void BM_IndividualFrees(benchmark::State &state)
+    {
+        BuddyAllocator heap(16);
+        std::vector<uint16_t> sizes = nodeSizes(size_t(state.range(0)));
+        std::vector<char*> nodes(sizes.size());
+
+        for (auto _ : state) {
+            state.PauseTiming();
+            for (size_t i = 0; i < sizes.size(); ++i) {
+                nodes[i] = heap.alloc(sizes[i]);
+            }
+            state.ResumeTiming();
+
+            for (char *node : nodes) {
+                heap.free(node);
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(BM_IndividualFrees)->Arg(64)->Arg(512);
+
+    // the same teardown as a scope's rollback, sorted by address
+    void BM_ScopeRollback(benchmark::State &state)
+    {
+        BuddyAllocator heap(16);
+        std::vector<uint16_t> sizes = nodeSizes(size_t(state.range(0)));
+
+        for (auto _ : state) {
+            state.PauseTiming();
+            AllocationScope scope(heap);
+            for (uint16_t size : sizes) {
+                scope.alloc(size);
+            }
+            state.ResumeTiming();
+
+            scope.rollback();
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(BM_ScopeRollback)->Arg(64)->Arg(512);
+
+    // what recording costs on the way in, against allocating straight from the heap
+    void BM_ScopeCommit(benchmark::State &state)
+    {
+        // BuddyAllocator is over-aligned, which plain new doesn't do before C++17
+        std::aligned_storage<sizeof(BuddyAllocator), alignof(BuddyAllocator)>::type storage;
+        BuddyAllocator *heap = new (&storage) BuddyAllocator(16);
+        std::vector<uint16_t> sizes = nodeSizes(size_t(state.range(0)));
+        std::vector<char*> nodes;
+
+        for (auto _ : state) {
+            if (state.range(1)) {
+                AllocationScope scope(*heap);
+                for (uint16_t size : sizes) {
+                    scope.alloc(size);
+                }
+                scope.commit();
+            } else {
+                nodes.clear();
+                for (uint16_t size : sizes) {
+                    nodes.push_back(heap->alloc(size));
+                }
+            }
+
+            // a committed scope leaves nothing to free with, so start every iteration on a new heap
+            state.PauseTiming();
+            heap->~BuddyAllocator();
+            heap = new (&storage) BuddyAllocator(16);
+            state.ResumeTiming();
+        }
+        heap->~BuddyAllocator();
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(BM_ScopeCommit)->ArgNames({ "nodes", "scoped" })->Args({ 512, 0 })->Args({ 512, 1 });
+}
@@ -0,0 +1,66 @@
+#include "BuddyEngine.h"
+#include "BuddyAllocator.h"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+namespace
+{
+    // a cheap generator, so the benchmark measures the engine rather than the random numbers
+    struct Xorshift
+    {
+        uint64_t state = 88172645463325252ull;
+
+        uint64_t operator()()
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return state;
+        }
+    };
+
+    const size_t LiveBlocks = 4096;
+
+    // every iteration frees the oldest of LiveBlocks blocks and allocates a new one of 2^3 to 2^10 units
+    void BM_EngineAllocFree(benchmark::State &state)
+    {
+        BuddyEngine engine(24, 3);
+        std::vector<uint64_t> live(LiveBlocks, BuddyEngine::None);
+        Xorshift random;
+        size_t oldest = 0;
+
+        for (auto _ : state) {
+            if (live[oldest] != BuddyEngine::None) {
+                engine.free(live[oldest]);
+            }
+            live[oldest] = engine.alloc(uint8_t(3 + random() % 8));
+            benchmark::DoNotOptimize(live[oldest]);
+            oldest = (oldest + 1) % LiveBlocks;
+        }
+
+        state.counters["splits"] = double(engine.splits());
+        state.counters["coalesces"] = double(engine.coalesces());
+    }
+    BENCHMARK(BM_EngineAllocFree)->Iterations(100000000);
+
+    // the same trace through the allocator, for what mapping offsets to memory adds
+    void BM_AllocatorAllocFree(benchmark::State &state)
+    {
+        BuddyAllocator allocator(16);
+        std::vector<char*> live(64, nullptr);
+        Xorshift random;
+        size_t oldest = 0;
+
+        for (auto _ : state) {
+            if (live[oldest]) {
+                allocator.free(live[oldest]);
+            }
+            live[oldest] = allocator.tryAlloc(uint16_t(8 << (random() % 6)));
+            benchmark::DoNotOptimize(live[oldest]);
+            oldest = (oldest + 1) % live.size();
+        }
+    }
+    BENCHMARK(BM_AllocatorAllocFree);
+}
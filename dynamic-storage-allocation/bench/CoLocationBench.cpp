@@ -0,0 +1,85 @@
+#include "BuddyAllocator.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    struct Node
+    {
+        Node *next;
+        uint64_t *payload;
+    };
+
+    const int Lists = 32;
+    const int NodesPerList = 16;
+
+    /*
+     * Builds 32 lists of 16 nodes, each node with a 48 byte payload, one node per list at a time as interleaved
+     * structures tend to grow. Grouped, every list gets a 2K parent block of its own for its nodes and payloads; otherwise
+     * consecutive nodes of a list end up a whole round of allocations apart.
+     * */
+    std::vector<Node*> build(BuddyAllocator &heap, bool grouped)
+    {
+        std::vector<Node*> heads(Lists, nullptr), tails(Lists, nullptr);
+
+        for (int i = 0; i < NodesPerList; ++i) {
+            for (int list = 0; list < Lists; ++list) {
+                // a group starts out as a parent block of its own, any address in it will do
+                const char *near = heads[list] ? (const char*) heads[list] : heap.base() + list * 2048;
+                Node *node = (Node*) (grouped ? heap.allocNear(sizeof(Node), near, 11) : heap.alloc(sizeof(Node)));
+                node->next = nullptr;
+                node->payload = (uint64_t*) (grouped ? heap.allocNear(48, (const char*) node, 11) : heap.alloc(48));
+                for (int word = 0; word < 6; ++word) {
+                    node->payload[word] = uint64_t(i + word);
+                }
+
+                if (tails[list]) {
+                    tails[list]->next = node;
+                } else {
+                    heads[list] = node;
+                }
+                tails[list] = node;
+            }
+        }
+
+        return heads;
+    }
+
+    void BM_Traversal(benchmark::State &state)
+    {
+        BuddyAllocator heap(16);
+        std::vector<Node*> heads = build(heap, state.range(0) != 0);
+
+        for (auto _ : state) {
+            uint64_t sum = 0;
+            for (Node *head : heads) {
+                for (Node *node = head; node; node = node->next) {
+                    for (int word = 0; word < 6; ++word) {
+                        sum += node->payload[word];
+                    }
+                }
+            }
+            benchmark::DoNotOptimize(sum);
+        }
+
+        // how many distinct 2K parents the nodes of a list are spread over, on average
+        size_t parents = 0;
+        for (Node *head : heads) {
+            std::vector<uintptr_t> seen;
+            for (Node *node = head; node; node = node->next) {
+                for (uintptr_t parent : { uintptr_t(node) >> 11, uintptr_t(node->payload) >> 11 }) {
+                    if (std::find(seen.begin(), seen.end(), parent) == seen.end()) {
+                        seen.push_back(parent);
+                    }
+                }
+            }
+            parents += seen.size();
+        }
+        state.counters["parents_per_list"] = double(parents) / Lists;
+        state.SetItemsProcessed(state.iterations() * Lists * NodesPerList);
+    }
+    BENCHMARK(BM_Traversal)->ArgName("grouped")->Arg(0)->Arg(1);
+}
@@ -0,0 +1,165 @@
+#include "EpochReclaimer.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const int Threads = 4;
+    const int OpsPerThread = 200000;
+    const size_t Slots = 1024;
+
+    struct Node
+    {
+        uint64_t key;
+        uint64_t value;
+    };
+
+    /*
+     * A lock free map with one node per slot: a lookup loads the slot and reads the node, an update puts a fresh copy in
+     * and gets rid of the old one. That last part is what differs: the EBR map retires it to an EpochReclaimer over a
+     * 64K heap, the leaky one never frees and takes its nodes from a bump pointer instead.
+     * */
+    struct EpochMap
+    {
+        BuddyAllocator heap;
+        LockedAllocator allocator;
+        EpochReclaimer reclaimer;
+
+        EpochMap() : heap(16), allocator(heap), reclaimer(allocator) {}
+
+        struct Thread
+        {
+            EpochMap &map;
+            EpochReclaimer::Participant self;
+
+            explicit Thread(EpochMap &map) : map(map), self(map.reclaimer) {}
+
+            void pin() { self.pin(); }
+            void unpin() { self.unpin(); }
+            // a thread preempted while pinned holds the epoch back, and with it everything retired since. Step out of
+            // the way until the heap has room again
+            Node *make()
+            {
+                while (true) {
+                    try {
+                        return reinterpret_cast<Node*>(map.allocator.alloc(sizeof(Node)));
+                    } catch (const char *) {
+                        ++waits;
+                        self.unpin();
+                        std::this_thread::yield();
+                        self.pin();
+                    }
+                }
+            }
+
+            void dispose(Node *node) { self.retire(reinterpret_cast<char*>(node)); }
+
+            uint64_t waits = 0;
+        };
+
+        uint64_t held() const { return heap.capacity() - freeBytes(); }
+
+        uint64_t freeBytes() const
+        {
+            BuddyAllocator::Stats stats = heap.stats();
+            uint64_t bytes = 0;
+            for (int k = 0; k <= BuddyAllocator::MaxOrder; ++k) {
+                bytes += uint64_t(stats.freeBlocks[k]) << k;
+            }
+            return bytes;
+        }
+    };
+
+    struct LeakyMap
+    {
+        std::vector<char> slab;
+        std::atomic<size_t> used;
+
+        LeakyMap() : slab(size_t(Threads) * OpsPerThread * sizeof(Node) + Slots * sizeof(Node)), used(0) {}
+
+        struct Thread
+        {
+            LeakyMap &map;
+
+            explicit Thread(LeakyMap &map) : map(map) {}
+
+            void pin() {}
+            void unpin() {}
+            Node *make() { return reinterpret_cast<Node*>(&map.slab[map.used.fetch_add(sizeof(Node))]); }
+            void dispose(Node *) {}
+
+            uint64_t waits = 0;
+        };
+
+        uint64_t held() const { return used.load(); }
+    };
+
+    // the argument is the share of updates, in percent
+    template <typename Map>
+    void BM_ConcurrentMap(benchmark::State &state)
+    {
+        uint64_t held = 0;
+        std::atomic<uint64_t> waits(0);
+
+        for (auto _ : state) {
+            Map map;
+            std::atomic<Node*> slots[Slots];
+            {
+                typename Map::Thread setup(map);
+                for (size_t i = 0; i < Slots; ++i) {
+                    slots[i].store(new (setup.make()) Node{ i, 0 });
+                }
+            }
+
+            std::vector<std::thread> threads;
+            for (int t = 0; t < Threads; ++t) {
+                threads.emplace_back([&, t] {
+                    typename Map::Thread self(map);
+                    uint64_t random = 88172645463325252ull + t, sum = 0;
+
+                    for (int i = 0; i < OpsPerThread; ++i) {
+                        random ^= random << 13;
+                        random ^= random >> 7;
+                        random ^= random << 17;
+
+                        std::atomic<Node*> &slot = slots[random % Slots];
+                        self.pin();
+                        if (int64_t(uint32_t(random >> 32) % 100) < state.range(0)) {
+                            // allocate before looking, make() may have to unpin
+                            Node *fresh = new (self.make()) Node();
+                            Node *old = slot.load();
+                            *fresh = Node{ old->key, old->value + 1 };
+                            self.dispose(slot.exchange(fresh));
+                        } else {
+                            sum += slot.load()->value;
+                        }
+                        self.unpin();
+                    }
+                    benchmark::DoNotOptimize(sum);
+                    waits += self.waits;
+                });
+            }
+            for (auto && thread : threads) {
+                thread.join();
+            }
+
+            held = map.held();
+            typename Map::Thread teardown(map);
+            teardown.pin();
+            for (auto && slot : slots) {
+                teardown.dispose(slot.load());
+            }
+            teardown.unpin();
+        }
+
+        state.SetItemsProcessed(state.iterations() * Threads * OpsPerThread);
+        state.counters["held_bytes"] = double(held);
+        state.counters["heap_full_waits"] = double(waits.load());
+    }
+    BENCHMARK_TEMPLATE(BM_ConcurrentMap, EpochMap)->ArgName("updates")->Arg(10)->Arg(50)->UseRealTime()->Unit(benchmark::kMillisecond);
+    BENCHMARK_TEMPLATE(BM_ConcurrentMap, LeakyMap)->ArgName("updates")->Arg(10)->Arg(50)->UseRealTime()->Unit(benchmark::kMillisecond);
+}
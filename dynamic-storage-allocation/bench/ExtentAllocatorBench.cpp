@@ -0,0 +1,84 @@
+#include "ExtentAllocator.h"
+
+#include <benchmark/benchmark.h>
+
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <vector>
+
+namespace
+{
+    // the local file the extents are carved from, under /tmp. Fixed at startup, so a forked child uses it too
+    const std::string &extentPath()
+    {
+        static const std::string path = "/tmp/extent-bench." + std::to_string(getpid());
+        return path;
+    }
+
+    void removeExtentFiles()
+    {
+        remove((extentPath() + ".bitmap").c_str());
+        remove((extentPath() + ".journal").c_str());
+    }
+
+    // 4K to 512K extents against a window of 1024 live ones, journal syncs included
+    void BM_ExtentAllocFree(benchmark::State &state)
+    {
+        removeExtentFiles();
+        {
+            ExtentAllocator extents(extentPath(), 30, 12);
+            std::vector<uint64_t> live(1024, BuddyEngine::None);
+            size_t oldest = 0;
+
+            for (auto _ : state) {
+                if (live[oldest] != BuddyEngine::None) {
+                    extents.free(live[oldest]);
+                }
+                live[oldest] = extents.alloc(uint64_t(4096) << (oldest % 8));
+                oldest = (oldest + 1) % live.size();
+            }
+        }
+        removeExtentFiles();
+    }
+    BENCHMARK(BM_ExtentAllocFree);
+
+    // reopening after a crash that left range(0) journal records behind the checkpoint
+    void BM_ExtentRecovery(benchmark::State &state)
+    {
+        removeExtentFiles();
+        extentPath();
+
+        pid_t child = fork();
+        if (child == 0) {
+            ExtentAllocator extents(extentPath(), 30, 12);
+            std::vector<uint64_t> live;
+            for (int64_t i = 0; i < state.range(0); ++i) {
+                if (i % 3 == 2) {
+                    extents.free(live.back());
+                    live.pop_back();
+                } else {
+                    live.push_back(extents.alloc(uint64_t(4096) << (i % 4)));
+                }
+            }
+            extents.sync();
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(child, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            state.SkipWithError("writing the journal failed");
+            return;
+        }
+
+        for (auto _ : state) {
+            // recovery leaves the journal as it found it, so every iteration replays the same records
+            ExtentAllocator extents(extentPath(), 30, 12);
+            benchmark::DoNotOptimize(extents.engine().largestFree());
+        }
+
+        removeExtentFiles();
+    }
+    BENCHMARK(BM_ExtentRecovery)->Arg(1000)->Arg(30000)->Unit(benchmark::kMillisecond);
+}
@@ -0,0 +1,31 @@
+#include "BuddyAllocator.h"
+
+#include <benchmark/benchmark.h>
+
+namespace
+{
+    // requests of 16 bytes to 4K; the argument is the guard threshold, 0 for none
+    void BM_GuardThreshold(benchmark::State &state)
+    {
+        BuddyAllocator allocator(16);
+        allocator.guardLargeAllocations(uint16_t(state.range(0)));
+
+        char *live[32] = {};
+        size_t oldest = 0;
+
+        for (auto _ : state) {
+            if (live[oldest]) {
+                allocator.free(live[oldest]);
+            }
+            live[oldest] = allocator.tryAlloc(uint16_t(16 << (oldest % 9)));
+            oldest = (oldest + 1) % 32;
+        }
+
+        for (char *address : live) {
+            if (address) {
+                allocator.free(address);
+            }
+        }
+    }
+    BENCHMARK(BM_GuardThreshold)->Arg(0)->Arg(4096)->Arg(1024)->Arg(256)->Arg(16);
+}
@@ -0,0 +1,77 @@
+#include "AllocatorHooks.h"
+#include "BuddyAllocator.h"
+
+#include <benchmark/benchmark.h>
+
+/*
+ * Built twice, as buddy_hooks_bench against the heap as it is and as buddy_no_hooks_bench against a copy compiled with
+ * BUDDY_NO_HOOKS. Hooks cannot be unlinked once registered, so these run in registration order, none registered first,
+ * and live in executables of their own where they cannot slow down anybody else's benchmarks.
+ * */
+namespace
+{
+    // 64 blocks of 8 to 256 bytes, the oldest replaced every time, so splits and coalesces run all the while
+    void churn(benchmark::State &state)
+    {
+        BuddyAllocator allocator(16);
+        char *live[64] = {};
+        size_t oldest = 0;
+
+        for (auto _ : state) {
+            if (live[oldest]) {
+                allocator.free(live[oldest]);
+            }
+            live[oldest] = allocator.alloc(uint16_t(8 << (oldest % 6)));
+            oldest = (oldest + 1) % 64;
+        }
+
+        for (char *address : live) {
+            if (address) {
+                allocator.free(address);
+            }
+        }
+    }
+
+#if defined(BUDDY_NO_HOOKS)
+    void BM_HooksCompiledOut(benchmark::State &state)
+    {
+        churn(state);
+    }
+    BENCHMARK(BM_HooksCompiledOut);
+#else
+    uint64_t splits = 0;
+
+    AllocatorHooks counting;
+
+    void countSplit(void *, const BuddyEngine *, uint64_t, uint8_t)
+    {
+        ++splits;
+    }
+
+    void BM_NoHooksRegistered(benchmark::State &state)
+    {
+        churn(state);
+    }
+    BENCHMARK(BM_NoHooksRegistered);
+
+    // what a profiler that has come and gone leaves behind: a list to walk on every event, with nothing switched on
+    void BM_HooksUnregistered(benchmark::State &state)
+    {
+        counting.onSplit = countSplit;
+        registerHooks(&counting);
+        unregisterHooks(&counting);
+        churn(state);
+    }
+    BENCHMARK(BM_HooksUnregistered);
+
+    void BM_SplitHookActive(benchmark::State &state)
+    {
+        splits = 0;
+        registerHooks(&counting);
+        churn(state);
+        unregisterHooks(&counting);
+        state.counters["splits"] = benchmark::Counter(double(splits), benchmark::Counter::kAvgIterations);
+    }
+    BENCHMARK(BM_SplitHookActive);
+#endif
+}
@@ -0,0 +1,114 @@
+#include "LifetimeAllocator.h"
+
+#include <benchmark/benchmark.h>
+
+#include <queue>
+#include <random>
+#include <vector>
+
+namespace
+{
+    const int TraceOps = 250000;
+    const int Seeds = 8;
+    const int LargeEvery = 5000;            // ops between two attempts at a large allocation
+
+    struct Expiry
+    {
+        uint64_t when;
+        char *address;
+
+        bool operator<(const Expiry &other) const { return when > other.when; }
+    };
+
+    // two call sites for LifetimeAllocator to tell apart: one whose blocks die young, one whose blocks stay
+    __attribute__((noinline)) char *shortLivedSite(Allocator &allocator, uint16_t bytes) { return allocator.alloc(bytes); }
+    __attribute__((noinline)) char *longLivedSite(Allocator &allocator, uint16_t bytes) { return allocator.alloc(bytes); }
+
+    double fragmentation(const BuddyAllocator &heap)
+    {
+        BuddyAllocator::Stats stats = heap.stats();
+        uint64_t freeBytes = 0;
+        for (int k = 0; k <= BuddyAllocator::MaxOrder; ++k) {
+            freeBytes += uint64_t(stats.freeBlocks[k]) << k;
+        }
+        return freeBytes ? 1.0 - double(stats.largestFree) / freeBytes : 0.0;
+    }
+
+    struct Outcome
+    {
+        uint64_t largeTried, largeMade, failures;
+        double fragmentationSum;
+    };
+
+    /*
+     * A trace of 16-128 byte blocks: 94% live for up to shortLife allocations, 6% for 2000-6000. Every 5000 ops a large
+     * allocation of largeBytes is attempted and released again, which needs that much of the arena in one piece.
+     * */
+    void replay(BuddyAllocator &heap, Allocator &allocator, uint32_t seed, uint32_t shortLife, uint16_t largeBytes, Outcome &outcome)
+    {
+        std::mt19937 random(seed);
+        std::priority_queue<Expiry> live;
+
+        for (uint64_t now = 0; now < uint64_t(TraceOps); ++now) {
+            while (!live.empty() && live.top().when <= now) {
+                allocator.free(live.top().address);
+                live.pop();
+            }
+
+            bool longLived = random() % 100 < 6;
+            uint16_t bytes = uint16_t(16 << (random() % 4));
+            try {
+                char *address = longLived ? longLivedSite(allocator, bytes) : shortLivedSite(allocator, bytes);
+                uint64_t life = longLived ? 2000 + random() % 4000 : 1 + random() % shortLife;
+                live.push(Expiry{ now + life, address });
+            } catch (const char *) {
+                ++outcome.failures;
+            }
+
+            if (now % LargeEvery == LargeEvery - 1) {
+                ++outcome.largeTried;
+                outcome.fragmentationSum += fragmentation(heap);
+                if (char *large = heap.tryAlloc(largeBytes)) {
+                    ++outcome.largeMade;
+                    heap.free(large);
+                }
+            }
+        }
+
+        while (!live.empty()) {
+            allocator.free(live.top().address);
+            live.pop();
+        }
+    }
+
+    /*
+     * The same trace from 8 seeds, as the heap fares very differently from one to the next. The arguments are whether
+     * to segregate, the lifetime of short-lived blocks (200 keeps the heap a third full, 1000 two thirds), and the size
+     * of the large allocation.
+     * */
+    void BM_LifetimeTrace(benchmark::State &state)
+    {
+        Outcome outcome = {};
+
+        for (auto _ : state) {
+            outcome = Outcome();
+            for (uint32_t seed = 1; seed <= Seeds; ++seed) {
+                BuddyAllocator heap(16);
+                uint32_t shortLife = uint32_t(state.range(1));
+                uint16_t largeBytes = uint16_t(state.range(2));
+                if (state.range(0)) {
+                    LifetimeAllocator lifetimes(heap);
+                    replay(heap, lifetimes, seed, shortLife, largeBytes, outcome);
+                } else {
+                    replay(heap, heap, seed, shortLife, largeBytes, outcome);
+                }
+            }
+        }
+
+        state.counters["large_success"] = double(outcome.largeMade) / outcome.largeTried;
+        state.counters["fragmentation"] = outcome.fragmentationSum / outcome.largeTried;
+        state.counters["failures"] = double(outcome.failures);
+    }
+    BENCHMARK(BM_LifetimeTrace)->ArgNames({ "segregated", "short", "large" })
+        ->ArgsProduct({ { 0, 1 }, { 200, 1000 }, { 8192, 16384, 32768 } })->Iterations(1)->Unit(benchmark::kMillisecond);
+}
@@ -0,0 +1,90 @@
+#include "LineAllocator.h"
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const int ObjectsPerThread = 64;
+    const int WritesPerObject = 4096;
+    const uint16_t ObjectBytes = 16;
+
+    enum Placement { Heap, Lines };
+
+    /*
+     * Every thread gets 64 counters of 16 bytes, allocated for all threads in turn the way a busy server hands them out,
+     * and bumps each of them 4096 times before freeing them. Straight from the heap neighbouring counters belong to
+     * different threads; through a LineAllocator a thread owns every line its counters are on. Only the writes are
+     * timed. The arguments are the placement and the number of threads; shared_lines counts the lines holding counters
+     * of more than one thread.
+     * */
+    void BM_FreshWrites(benchmark::State &state)
+    {
+        Placement placement = Placement(state.range(0));
+        int threadCount = int(state.range(1));
+        uint64_t sharedLines = 0;
+
+        for (auto _ : state) {
+            BuddyAllocator heap(16);
+            LockedAllocator allocator(heap);
+            LineAllocator lines(allocator);
+
+            std::vector<std::unique_ptr<LineAllocator::Local>> locals;
+            std::vector<std::vector<char*>> objects(threadCount);
+            for (int t = 0; t < threadCount; ++t) {
+                locals.emplace_back(new LineAllocator::Local(lines));
+            }
+            for (int i = 0; i < ObjectsPerThread; ++i) {
+                for (int t = 0; t < threadCount; ++t) {
+                    objects[t].push_back(placement == Lines ? locals[t]->alloc(ObjectBytes) : allocator.alloc(ObjectBytes));
+                }
+            }
+
+            std::set<uintptr_t> seen;
+            sharedLines = 0;
+            for (int t = 0; t < threadCount; ++t) {
+                std::set<uintptr_t> own;
+                for (char *address : objects[t]) {
+                    own.insert(uintptr_t(address) >> LineAllocator::LineOrder);
+                }
+                for (uintptr_t line : own) {
+                    sharedLines += !seen.insert(line).second;
+                }
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> threads;
+            for (int t = 0; t < threadCount; ++t) {
+                threads.emplace_back([&, t] {
+                    for (char *address : objects[t]) {
+                        volatile uint64_t *counter = reinterpret_cast<uint64_t*>(address);
+                        *counter = 0;
+                        for (int i = 0; i < WritesPerObject; ++i) {
+                            *counter = *counter + 1;
+                        }
+                    }
+                });
+            }
+            for (auto && thread : threads) {
+                thread.join();
+            }
+            state.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+            for (int t = 0; t < threadCount; ++t) {
+                for (char *address : objects[t]) {
+                    lines.free(address);
+                }
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * threadCount * ObjectsPerThread * WritesPerObject);
+        state.counters["shared_lines"] = double(sharedLines);
+    }
+    BENCHMARK(BM_FreshWrites)->ArgNames({ "lines", "threads" })->ArgsProduct({ { Heap, Lines }, { 1, 2, 4, 8 } })
+        ->UseManualTime()->Unit(benchmark::kMicrosecond);
+}
@@ -0,0 +1,91 @@
+#include "MobilityAllocator.h"
+
+#include <benchmark/benchmark.h>
+
+#include <queue>
+#include <random>
+
+namespace
+{
+    const int Days = 15;
+    const int OpsPerDay = 200000;
+    const int PeakOps = 50000;              // the busy part of every day
+    const uint16_t LargeBytes = 16384;      // a quarter of the arena
+    const uint8_t LargeOrder = 14;
+
+    struct Expiry
+    {
+        uint64_t when;
+        char *address;
+
+        bool operator<(const Expiry &other) const { return when > other.when; }
+    };
+
+    /*
+     * Days of churn on a 64K arena. Movable and reclaimable blocks of 16-256 bytes live up to 100 allocations, except at
+     * the peak of the day, when they live up to 800 and fill most of the arena. perMille blocks in a thousand
+     * are unmovable, 16 bytes, and live for about a day, so those allocated at the peak land wherever the crowd left
+     * room. At the end of every day, well past the peak, we look whether a 16K block could be had; the unmovable blocks
+     * are what stands in the way. Grouping uses regions of 16K, the block we want to keep coming back.
+     * */
+    void BM_MobilityReplay(benchmark::State &state)
+    {
+        bool grouped = state.range(0);
+        uint32_t perMille = uint32_t(state.range(1));
+        int largeDays = 0;
+        double largestSum = 0;
+        uint64_t failures = 0;
+
+        for (auto _ : state) {
+            BuddyAllocator heap(16);
+            MobilityAllocator mobility(heap, LargeOrder);
+            std::mt19937 random(7);
+            std::priority_queue<Expiry> live;
+            uint64_t now = 0;
+            largeDays = 0;
+            largestSum = 0;
+
+            for (int day = 0; day < Days; ++day) {
+                for (int op = 0; op < OpsPerDay; ++op, ++now) {
+                    while (!live.empty() && live.top().when <= now) {
+                        if (grouped) {
+                            mobility.free(live.top().address);
+                        } else {
+                            heap.free(live.top().address);
+                        }
+                        live.pop();
+                    }
+
+                    uint32_t kind = random() % 1000;
+                    bool unmovable = kind < perMille;
+                    MobilityAllocator::Mobility class_ = unmovable ? MobilityAllocator::Mobility::Unmovable
+                                                       : kind < 300 ? MobilityAllocator::Mobility::Reclaimable
+                                                       : MobilityAllocator::Mobility::Movable;
+                    uint16_t bytes = unmovable ? 16 : uint16_t(16 << (random() % 5));
+                    bool peak = op < PeakOps;
+                    uint64_t life = unmovable ? OpsPerDay / 2 + random() % OpsPerDay : 1 + random() % (peak ? 800 : 100);
+
+                    try {
+                        char *address = grouped ? mobility.alloc(bytes, class_) : heap.alloc(bytes);
+                        live.push(Expiry{ now + life, address });
+                    } catch (const char *) {
+                        ++failures;
+                    }
+                }
+
+                largeDays += heap.stats().largestFree >= LargeBytes;
+                largestSum += heap.stats().largestFree;
+            }
+
+            while (!live.empty()) {
+                heap.free(live.top().address);
+                live.pop();
+            }
+        }
+
+        state.counters["days_with_16k"] = largeDays;
+        state.counters["mean_largest_free"] = largestSum / Days;
+        state.counters["failures"] = double(failures);
+    }
+    BENCHMARK(BM_MobilityReplay)->ArgNames({ "grouped", "unmovable" })->ArgsProduct({ { 0, 1 }, { 1, 3, 5 } })->Iterations(1)->Unit(benchmark::kMillisecond);
+}
@@ -0,0 +1,164 @@
+#include "PerCpuCache.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const int Threads = 256;
+    const int OpsPerThread = 20000;
+
+    uint64_t reservedBytes(const BuddyAllocator &heap)
+    {
+        BuddyAllocator::Stats stats = heap.stats();
+        uint64_t freeBytes = 0;
+        for (int k = 0; k <= BuddyAllocator::MaxOrder; ++k) {
+            freeBytes += uint64_t(stats.freeBlocks[k]) << k;
+        }
+        return heap.capacity() - freeBytes;
+    }
+
+    // the per thread alternative: the same magazines, one set per thread, handed back when the thread is done
+    class ThreadCache
+    {
+    public:
+        explicit ThreadCache(LockedAllocator &allocator) : m_allocator(allocator), m_count() {}
+
+        ~ThreadCache()
+        {
+            for (int k = 0; k <= 10; ++k) {
+                m_allocator.freeBatch(m_blocks[k], m_count[k]);
+            }
+        }
+
+        char *alloc(uint16_t bytes)
+        {
+            uint8_t k = BuddyAllocator::orderFor(bytes);
+            return m_count[k] ? m_blocks[k][--m_count[k]] : m_allocator.alloc(uint16_t(1u << k));
+        }
+
+        void free(char *address)
+        {
+            uint8_t k = uint8_t(__builtin_ctzll(m_allocator.blockSize(address)));
+            if (m_count[k] == PerCpuCache::MagazineSize) {
+                size_t half = PerCpuCache::MagazineSize / 2;
+                std::sort(m_blocks[k], m_blocks[k] + half);
+                m_allocator.freeBatch(m_blocks[k], half);
+                std::copy(m_blocks[k] + half, m_blocks[k] + PerCpuCache::MagazineSize, m_blocks[k]);
+                m_count[k] -= half;
+            }
+            m_blocks[k][m_count[k]++] = address;
+        }
+
+    private:
+        LockedAllocator &m_allocator;
+        uint16_t m_count[11];
+        char *m_blocks[11][PerCpuCache::MagazineSize];
+    };
+
+    enum Cache { None, PerThread, PerCpuFallback, PerCpuRseq };
+
+    /*
+     * 256 threads, each keeping 4 blocks of 8 to 64 bytes live and replacing the oldest one at a time. Once every thread
+     * is done and has freed what it held, whatever is still reserved in the heap is sitting in caches: that is the
+     * memory overhead. The argument picks the cache.
+     * */
+    void BM_CacheThreads(benchmark::State &state)
+    {
+        Cache kind = Cache(state.range(0));
+        uint64_t cached = 0;
+
+        for (auto _ : state) {
+            BuddyAllocator heap(16);
+            LockedAllocator allocator(heap);
+            PerCpuCache perCpu(allocator, 10, kind == PerCpuRseq);
+            if (kind == PerCpuRseq && !perCpu.usesRseq()) {
+                state.SkipWithError("rseq is not available");
+                return;
+            }
+
+            std::mutex mutex;
+            std::condition_variable measured;
+            int done = 0;
+            bool release = false;
+
+            std::vector<std::thread> threads;
+            for (int t = 0; t < Threads; ++t) {
+                threads.emplace_back([&] {
+                    ThreadCache perThread(allocator);
+                    auto alloc = [&](uint16_t bytes) {
+                        return kind == None ? allocator.alloc(bytes) : kind == PerThread ? perThread.alloc(bytes) : perCpu.alloc(bytes);
+                    };
+                    auto free = [&](char *address) {
+                        if (kind == None) {
+                            allocator.free(address);
+                        } else if (kind == PerThread) {
+                            perThread.free(address);
+                        } else {
+                            perCpu.free(address);
+                        }
+                    };
+
+                    char *live[4] = {};
+                    for (int i = 0; i < OpsPerThread; ++i) {
+                        if (live[i % 4]) {
+                            free(live[i % 4]);
+                        }
+                        live[i % 4] = alloc(uint16_t(8 << (i % 4)));
+                    }
+                    for (char *address : live) {
+                        free(address);
+                    }
+
+                    // stay around, with our cache, until it has been measured
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ++done;
+                    measured.notify_all();
+                    measured.wait(lock, [&] { return release; });
+                });
+            }
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                measured.wait(lock, [&] { return done == Threads; });
+                cached = reservedBytes(heap);
+                release = true;
+                measured.notify_all();
+            }
+            for (auto && thread : threads) {
+                thread.join();
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * Threads * OpsPerThread);
+        state.counters["cached_bytes"] = double(cached);
+    }
+    BENCHMARK(BM_CacheThreads)->ArgName("cache")->Arg(None)->Arg(PerThread)->Arg(PerCpuFallback)->Arg(PerCpuRseq)
+        ->UseRealTime()->Unit(benchmark::kMillisecond);
+
+    // one thread freeing and allocating the same block, so every call is a hit: the fast path alone
+    void BM_CacheHit(benchmark::State &state)
+    {
+        BuddyAllocator heap(16);
+        LockedAllocator allocator(heap);
+        PerCpuCache cache(allocator, 10, state.range(0) == PerCpuRseq);
+        if (state.range(0) == PerCpuRseq && !cache.usesRseq()) {
+            state.SkipWithError("rseq is not available");
+            return;
+        }
+
+        char *address = cache.alloc(64);
+        for (auto _ : state) {
+            cache.free(address);
+            address = cache.alloc(64);
+            benchmark::DoNotOptimize(address);
+        }
+        cache.free(address);
+    }
+    BENCHMARK(BM_CacheHit)->ArgName("cache")->Arg(PerCpuFallback)->Arg(PerCpuRseq);
+}
@@ -0,0 +1,58 @@
+#include "PersistentHeap.h"
+
+#include <benchmark/benchmark.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <vector>
+
+namespace
+{
+    std::string heapPath()
+    {
+        return "/tmp/persistent-heap-bench." + std::to_string(getpid());
+    }
+
+    // every alloc and free msyncs its redo log and then its tags, so this is mostly the cost of two flushes
+    void BM_PersistentAllocFree(benchmark::State &state)
+    {
+        remove(heapPath().c_str());
+        {
+            PersistentHeap heap(heapPath(), 24);
+            std::vector<char*> live(256, nullptr);
+            size_t oldest = 0;
+
+            for (auto _ : state) {
+                if (live[oldest]) {
+                    heap.free(live[oldest]);
+                }
+                live[oldest] = heap.alloc(uint16_t(16 << (oldest % 8)));
+                oldest = (oldest + 1) % live.size();
+            }
+        }
+        remove(heapPath().c_str());
+    }
+    BENCHMARK(BM_PersistentAllocFree);
+
+    // opening a 2^range(0) heap that is a quarter full of 64 byte blocks, which rebuilds the free lists from the tags
+    void BM_PersistentRecovery(benchmark::State &state)
+    {
+        uint8_t order = uint8_t(state.range(0));
+        remove(heapPath().c_str());
+        {
+            PersistentHeap heap(heapPath(), order);
+            for (size_t i = 0; i < (size_t(1) << order) / 4 / 64; ++i) {
+                heap.alloc(64);
+            }
+        }
+
+        for (auto _ : state) {
+            PersistentHeap heap(heapPath(), order);
+            benchmark::DoNotOptimize(heap.base());
+        }
+
+        remove(heapPath().c_str());
+    }
+    BENCHMARK(BM_PersistentRecovery)->Arg(20)->Arg(24)->Unit(benchmark::kMillisecond);
+}
@@ -0,0 +1,38 @@
+#include "ProfiledMutex.h"
+
+#include <benchmark/benchmark.h>
+
+#include <mutex>
+
+namespace
+{
+    // an uncontended lock and unlock, what every LockedAllocator call pays on top of the heap
+    template <typename Mutex>
+    void BM_LockUnlock(benchmark::State &state)
+    {
+        Mutex mutex;
+        uint64_t guarded = 0;
+
+        for (auto _ : state) {
+            std::lock_guard<Mutex> guard(mutex);
+            benchmark::DoNotOptimize(++guarded);
+        }
+    }
+    BENCHMARK_TEMPLATE(BM_LockUnlock, std::mutex);
+    BENCHMARK_TEMPLATE(BM_LockUnlock, ProfiledMutex);
+
+    // the same under contention, with the threads fighting over one mutex
+    template <typename Mutex>
+    void BM_ContendedLockUnlock(benchmark::State &state)
+    {
+        static Mutex mutex;
+        static uint64_t guarded = 0;
+
+        for (auto _ : state) {
+            std::lock_guard<Mutex> guard(mutex);
+            benchmark::DoNotOptimize(++guarded);
+        }
+    }
+    BENCHMARK_TEMPLATE(BM_ContendedLockUnlock, std::mutex)->Threads(4)->UseRealTime();
+    BENCHMARK_TEMPLATE(BM_ContendedLockUnlock, ProfiledMutex)->Threads(4)->UseRealTime();
+}
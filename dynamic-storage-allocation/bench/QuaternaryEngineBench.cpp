@@ -0,0 +1,67 @@
+#include "BuddyEngine.h"
+#include "QuaternaryEngine.h"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+namespace
+{
+    struct Xorshift
+    {
+        uint64_t state = 88172645463325252ull;
+
+        uint64_t operator()()
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return state;
+        }
+    };
+
+    const size_t LiveBlocks = 20000;
+
+    /*
+     * The same trace through both engines over a 2^24 range: every iteration frees the oldest of 20K live blocks and asks
+     * for a new one of 16 to 512 units. Both engines start at order 4, so the quaternary one has every even order.
+     * */
+    template <typename Engine>
+    void BM_Engine(benchmark::State &state)
+    {
+        Engine engine(24, 4);
+        std::vector<uint64_t> live(LiveBlocks, Engine::None);
+        std::vector<uint8_t> asked(LiveBlocks);
+        Xorshift random;
+        size_t oldest = 0;
+
+        for (auto _ : state) {
+            if (live[oldest] != Engine::None) {
+                engine.free(live[oldest]);
+            }
+            asked[oldest] = uint8_t(4 + random() % 6);
+            live[oldest] = engine.alloc(asked[oldest]);
+            benchmark::DoNotOptimize(live[oldest]);
+            oldest = (oldest + 1) % LiveBlocks;
+        }
+
+        // internal: what rounding up wasted inside the live blocks. external: free space outside the largest free block
+        uint64_t askedUnits = 0, reservedUnits = 0, freeUnits = 0;
+        for (size_t i = 0; i < LiveBlocks; ++i) {
+            if (live[i] != Engine::None) {
+                askedUnits += uint64_t(1) << asked[i];
+                reservedUnits += uint64_t(1) << engine.orderOf(live[i]);
+            }
+        }
+        for (int k = 0; k <= 24; ++k) {
+            freeUnits += engine.freeBlocks(uint8_t(k)) << k;
+        }
+
+        state.counters["splits"] = double(engine.splits());
+        state.counters["coalesces"] = double(engine.coalesces());
+        state.counters["internal_waste"] = 1.0 - double(askedUnits) / reservedUnits;
+        state.counters["external_fragmentation"] = 1.0 - double(uint64_t(1) << engine.largestFree()) / freeUnits;
+    }
+    BENCHMARK_TEMPLATE(BM_Engine, BuddyEngine)->Iterations(10000000);
+    BENCHMARK_TEMPLATE(BM_Engine, QuaternaryEngine)->Iterations(10000000);
+}
@@ -0,0 +1,79 @@
+#include "BuddyAllocator.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    const size_t FirstBytes = 20000;
+    const size_t LastBytes = size_t(80) << 20;
+
+    /*
+     * A buffer that starts at 20K and doubles up to 80MB, filling whatever it gained each time, while 64 blocks of
+     * 64 bytes stay live in a 64K arena. With mapLargeAllocations at 16K the buffer is mapped from the start and every
+     * step is an mremap; the arena's largest free block shows whether the buffer ever got in the way.
+     * */
+    void BM_ReallocGrowth(benchmark::State &state)
+    {
+        uint64_t smallestLargest = ~uint64_t(0);
+
+        for (auto _ : state) {
+            BuddyAllocator heap(16);
+            heap.mapLargeAllocations(16384);
+
+            char *small[64];
+            for (char *&address : small) {
+                address = heap.alloc(64);
+            }
+
+            size_t bytes = FirstBytes;
+            char *buffer = heap.realloc(nullptr, bytes);
+            memset(buffer, 1, bytes);
+
+            while (bytes < LastBytes) {
+                buffer = heap.realloc(buffer, 2 * bytes);
+                if (!buffer) {
+                    state.SkipWithError("realloc failed");
+                    return;
+                }
+                memset(buffer + bytes, 1, bytes);
+                bytes *= 2;
+                smallestLargest = std::min<uint64_t>(smallestLargest, heap.stats().largestFree);
+            }
+
+            heap.free(buffer);
+            for (char *address : small) {
+                heap.free(address);
+            }
+        }
+
+        state.counters["smallest_largest_free"] = double(smallestLargest);
+    }
+    BENCHMARK(BM_ReallocGrowth)->Unit(benchmark::kMillisecond);
+
+    // the same growth by allocating, copying and freeing, what realloc costs without mremap
+    void BM_CopyGrowth(benchmark::State &state)
+    {
+        for (auto _ : state) {
+            size_t bytes = FirstBytes;
+            char *buffer = static_cast<char*>(std::malloc(bytes));
+            memset(buffer, 1, bytes);
+
+            while (bytes < LastBytes) {
+                char *grown = static_cast<char*>(std::malloc(2 * bytes));
+                memcpy(grown, buffer, bytes);
+                memset(grown + bytes, 1, bytes);
+                std::free(buffer);
+                buffer = grown;
+                bytes *= 2;
+            }
+
+            benchmark::DoNotOptimize(buffer);
+            std::free(buffer);
+        }
+    }
+    BENCHMARK(BM_CopyGrowth)->Unit(benchmark::kMillisecond);
+}
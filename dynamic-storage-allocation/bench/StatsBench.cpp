@@ -0,0 +1,58 @@
+#include "BuddyAllocator.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <thread>
+
+namespace
+{
+    void churn(benchmark::State &state, BuddyAllocator &allocator)
+    {
+        char *live[64] = {};
+        size_t oldest = 0;
+
+        for (auto _ : state) {
+            if (live[oldest]) {
+                allocator.free(live[oldest]);
+            }
+            live[oldest] = allocator.tryAlloc(uint16_t(8 << (oldest % 6)));
+            oldest = (oldest + 1) % 64;
+        }
+
+        for (char *address : live) {
+            if (address) {
+                allocator.free(address);
+            }
+        }
+    }
+
+    void BM_AllocWithoutReader(benchmark::State &state)
+    {
+        BuddyAllocator allocator(16);
+        churn(state, allocator);
+    }
+    BENCHMARK(BM_AllocWithoutReader);
+
+    // a monitoring thread reading stats() in a tight loop, which it may do without ever holding the allocator up
+    void BM_AllocWithPollingReader(benchmark::State &state)
+    {
+        BuddyAllocator allocator(16);
+        std::atomic<bool> done(false);
+        uint64_t reads = 0;
+
+        std::thread reader([&] {
+            while (!done.load(std::memory_order_relaxed)) {
+                benchmark::DoNotOptimize(allocator.stats().liveBytes);
+                ++reads;
+            }
+        });
+
+        churn(state, allocator);
+
+        done = true;
+        reader.join();
+        state.counters["reads"] = double(reads);
+    }
+    BENCHMARK(BM_AllocWithPollingReader)->UseRealTime();
+}
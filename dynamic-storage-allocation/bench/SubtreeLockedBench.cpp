@@ -0,0 +1,109 @@
+#include "SubtreeLockedAllocator.h"
+#include "LockedAllocator.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const int OpsPerThread = 100000;
+    const uint16_t LargeBytes = 16384;      // a quarter of the arena, one request in 256
+
+    // 64K in all, as eight 8K arenas of their own behind their own locks, a thread sticking to one of them
+    struct ShardedArenas
+    {
+        struct Shard
+        {
+            BuddyAllocator heap{ 13 };
+            LockedAllocator locked{ heap };
+        };
+
+        Shard shards[8];
+
+        char *alloc(uint16_t bytes, int thread) { return shards[thread % 8].locked.alloc(bytes); }
+
+        void free(char *address)
+        {
+            for (Shard &shard : shards) {
+                if (shard.locked.inArena(address)) {
+                    shard.locked.free(address);
+                    return;
+                }
+            }
+        }
+    };
+
+    struct GlobalLock
+    {
+        BuddyAllocator heap{ 16 };
+        LockedAllocator locked{ heap };
+
+        char *alloc(uint16_t bytes, int) { return locked.alloc(bytes); }
+        void free(char *address) { locked.free(address); }
+    };
+
+    struct Subtrees
+    {
+        SubtreeLockedAllocator allocator{ 16 };
+
+        char *alloc(uint16_t bytes, int) { return allocator.alloc(bytes); }
+        void free(char *address) { allocator.free(address); }
+    };
+
+    /*
+     * Every thread keeps 16 blocks of 16 to 256 bytes live and replaces the oldest one at a time; one request in 256 is
+     * for 16K instead, which a sharded arena cannot serve. The argument is the number of threads.
+     * */
+    template <typename Heap>
+    void BM_ThreadedChurn(benchmark::State &state)
+    {
+        int threadCount = int(state.range(0));
+        std::atomic<uint64_t> largeFailures(0);
+
+        for (auto _ : state) {
+            Heap heap;
+            std::vector<std::thread> threads;
+
+            for (int t = 0; t < threadCount; ++t) {
+                threads.emplace_back([&, t] {
+                    char *live[16] = {};
+                    uint64_t failures = 0;
+
+                    for (int i = 0; i < OpsPerThread; ++i) {
+                        char *&slot = live[i % 16];
+                        if (slot) {
+                            heap.free(slot);
+                            slot = nullptr;
+                        }
+
+                        uint16_t bytes = i % 256 == 255 ? LargeBytes : uint16_t(16 << (i % 5));
+                        try {
+                            slot = heap.alloc(bytes, t);
+                        } catch (const char *) {
+                            failures += bytes == LargeBytes;
+                        }
+                    }
+
+                    for (char *address : live) {
+                        if (address) {
+                            heap.free(address);
+                        }
+                    }
+                    largeFailures += failures;
+                });
+            }
+            for (auto && thread : threads) {
+                thread.join();
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * threadCount * OpsPerThread);
+        state.counters["large_failures"] = benchmark::Counter(double(largeFailures.load()), benchmark::Counter::kAvgIterations);
+    }
+    BENCHMARK_TEMPLATE(BM_ThreadedChurn, GlobalLock)->Arg(1)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond);
+    BENCHMARK_TEMPLATE(BM_ThreadedChurn, Subtrees)->Arg(1)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond);
+    BENCHMARK_TEMPLATE(BM_ThreadedChurn, ShardedArenas)->Arg(1)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond);
+}
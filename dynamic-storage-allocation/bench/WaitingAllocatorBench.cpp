@@ -0,0 +1,56 @@
+#include "WaitingAllocator.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const int Threads = 8;
+    const int OpsPerThread = 2000;
+
+    /*
+     * Sustained overload: 8 threads each keep up to 4 blocks of 256 bytes live in a 4K heap that holds 16, so half of
+     * all requests have to wait. With FIFO service nobody starves, which shows as a bounded longest wait.
+     * */
+    void BM_WaitingOverload(benchmark::State &state)
+    {
+        double longestWait = 0;
+
+        for (auto _ : state) {
+            BuddyAllocator heap(12);
+            WaitingAllocator allocator(heap);
+            std::vector<double> longest(Threads);
+            std::vector<std::thread> threads;
+
+            for (int t = 0; t < Threads; ++t) {
+                threads.emplace_back([&, t] {
+                    char *held[4] = {};
+                    for (int i = 0; i < OpsPerThread; ++i) {
+                        if (held[i % 4]) {
+                            allocator.free(held[i % 4]);
+                        }
+
+                        std::chrono::steady_clock::time_point asked = std::chrono::steady_clock::now();
+                        held[i % 4] = allocator.alloc(256);
+                        longest[t] = std::max(longest[t], std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - asked).count());
+                    }
+                    for (char *address : held) {
+                        allocator.free(address);
+                    }
+                });
+            }
+            for (auto && thread : threads) {
+                thread.join();
+            }
+
+            longestWait = std::max(longestWait, *std::max_element(longest.begin(), longest.end()));
+        }
+
+        state.SetItemsProcessed(state.iterations() * Threads * OpsPerThread);
+        state.counters["longest_wait_us"] = longestWait;
+    }
+    BENCHMARK(BM_WaitingOverload)->UseRealTime()->Unit(benchmark::kMillisecond);
+}
@@ -0,0 +1,211 @@
+#include "AllocationScope.h"
+#include "BuddyAllocator.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <new>
+#include <stdlib.h>
+#include <vector>
+
+TEST(AllocationScope, RollbackFreesEverything)
+{
+    BuddyAllocator heap(12);
+    {
+        AllocationScope scope(heap);
+        for (int i = 0; i < 20; ++i) {
+            scope.alloc(uint16_t(8 + i * 8));
+        }
+        EXPECT_GT(heap.stats().liveBytes, 0u);
+        scope.rollback();
+        EXPECT_EQ(heap.stats().liveBytes, 0u);
+    }
+    EXPECT_EQ(heap.largestFree(), 12);
+}
+
+TEST(AllocationScope, LeavingWithoutCommitRollsBack)
+{
+    BuddyAllocator heap(12);
+    try {
+        AllocationScope scope(heap);
+        scope.alloc(100);
+        scope.alloc(200);
+        throw "halfway";
+    } catch (const char *) {
+    }
+    EXPECT_EQ(heap.stats().liveBytes, 0u);
+}
+
+TEST(AllocationScope, CommitKeepsTheAllocations)
+{
+    BuddyAllocator heap(12);
+    std::vector<char*> kept;
+    {
+        AllocationScope scope(heap);
+        kept.push_back(scope.alloc(64));
+        kept.push_back(scope.alloc(64));
+        scope.commit();
+    }
+    EXPECT_EQ(heap.stats().liveBytes, 128u);
+
+    for (char *address : kept) {
+        heap.free(address);
+    }
+}
+
+TEST(AllocationScope, FreeInsideTheScopeIsForgotten)
+{
+    BuddyAllocator heap(12);
+    AllocationScope scope(heap);
+
+    char *a = scope.alloc(64);
+    scope.alloc(64);
+    scope.free(a);
+    EXPECT_EQ(heap.stats().liveBytes, 64u);
+
+    // rolling back must not free a a second time
+    EXPECT_NO_THROW(scope.rollback());
+    EXPECT_EQ(heap.stats().liveBytes, 0u);
+}
+
+TEST(AllocationScope, FailedAllocationLeavesTheScopeConsistent)
+{
+    BuddyAllocator heap(10);
+    {
+        AllocationScope scope(heap);
+        scope.alloc(512);
+        scope.alloc(256);
+        EXPECT_ANY_THROW(scope.alloc(512));
+    }
+    EXPECT_EQ(heap.largestFree(), 10);
+}
+
+namespace
+{
+    // passes everything on to a heap, noting the batches it is handed
+    class BatchCounter : public Allocator
+    {
+    public:
+        explicit BatchCounter(BuddyAllocator &heap) : m_heap(heap) {}
+
+        char *alloc(uint16_t bytes) override { return m_heap.alloc(bytes); }
+        void free(char *address) override { m_heap.free(address); }
+        void print() override { m_heap.print(); }
+
+        void freeBatch(char *const *addresses, size_t count) override
+        {
+            batches.push_back(std::vector<char*>(addresses, addresses + count));
+            m_heap.freeBatch(addresses, count);
+        }
+
+        std::vector<std::vector<char*>> batches;
+
+    private:
+        BuddyAllocator &m_heap;
+    };
+}
+
+TEST(AllocationScope, RollbackIsOneSortedBatch)
+{
+    BuddyAllocator heap(12);
+    BatchCounter counter(heap);
+    AllocationScope scope(counter);
+
+    for (int i = 0; i < 20; ++i) {
+        scope.alloc(uint16_t(8 << (i % 4)));
+    }
+    scope.rollback();
+
+    ASSERT_EQ(counter.batches.size(), 1u);
+    EXPECT_EQ(counter.batches[0].size(), 20u);
+    EXPECT_TRUE(std::is_sorted(counter.batches[0].begin(), counter.batches[0].end()));
+    EXPECT_EQ(heap.largestFree(), 12);
+}
+
+TEST(AllocationScope, AFailedRollbackIsNotRepeated)
+{
+    BuddyAllocator heap(12);
+    char *blocks[3];
+    {
+        AllocationScope scope(heap);
+        for (auto &block : blocks) {
+            block = scope.alloc(64);
+        }
+        std::sort(std::begin(blocks), std::end(blocks));
+
+        // freed behind the scope's back, so the rollback throws halfway
+        heap.free(blocks[1]);
+        EXPECT_ANY_THROW(scope.rollback());
+        EXPECT_EQ(heap.stats().liveBytes, 64u);
+
+        // nothing left for the destructor, which would have freed blocks[0] a second time and thrown
+    }
+
+    // the block after the failing one was never freed
+    EXPECT_EQ(heap.stats().liveBytes, 64u);
+    heap.free(blocks[2]);
+    EXPECT_EQ(heap.largestFree(), 12);
+}
+
+TEST(AllocationScope, DestructorSwallowsWhatTheAllocatorThrows)
+{
+    BuddyAllocator heap(12);
+    char *block;
+    {
+        AllocationScope scope(heap);
+        block = scope.alloc(64);
+        heap.free(block);
+    }
+    EXPECT_EQ(heap.largestFree(), 12);
+}
+
+namespace
+{
+    // operator new calls while counting is on, which inside a scope's alloc can only be the record growing
+    std::atomic<bool> counting(false);
+    std::atomic<size_t> news(0);
+}
+
+void *operator new(size_t bytes)
+{
+    if (counting.load(std::memory_order_relaxed)) {
+        ++news;
+    }
+    if (void *p = malloc(bytes ? bytes : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// GCC can't tell that this new and delete belong together
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void operator delete(void *p) noexcept
+{
+    ::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    ::free(p);
+}
+
+#pragma GCC diagnostic pop
+
+TEST(AllocationScope, RecordGrowsGeometrically)
+{
+    BuddyAllocator heap(16);
+    AllocationScope scope(heap);
+
+    counting = true;
+    for (int i = 0; i < 8000; ++i) {
+        scope.alloc(8);
+    }
+    counting = false;
+
+    EXPECT_LE(news.load(), 12u);
+    scope.rollback();
+}
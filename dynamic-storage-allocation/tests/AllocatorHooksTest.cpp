@@ -0,0 +1,120 @@
+#include "AllocatorHooks.h"
+#include "BuddyAllocator.h"
+#include "QuaternaryEngine.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+// with BUDDY_NO_HOOKS there is nothing to test
+#if !defined(BUDDY_NO_HOOKS)
+
+// hooks stay linked for the rest of the process, so every test switches its own off again before it is done
+namespace
+{
+    struct Events
+    {
+        uint64_t allocs, frees, splits, coalesces, grows, trims;
+    };
+
+    Events events;
+
+    void countAlloc(void *, const char *, size_t) { ++events.allocs; }
+    void countFree(void *, const char *, size_t) { ++events.frees; }
+    void countSplit(void *, const BuddyEngine *, uint64_t, uint8_t) { ++events.splits; }
+    void countCoalesce(void *, const BuddyEngine *, uint64_t, uint8_t) { ++events.coalesces; }
+    void countQuarterSplit(void *, const QuaternaryEngine *, uint64_t, uint8_t) { ++events.splits; }
+    void countQuarterCoalesce(void *, const QuaternaryEngine *, uint64_t, uint8_t) { ++events.coalesces; }
+    void countGrow(void *, const char *, size_t) { ++events.grows; }
+    void countTrim(void *, const char *, size_t) { ++events.trims; }
+
+    AllocatorHooks counting;
+
+    size_t timesLinked(const AllocatorHooks *hooks)
+    {
+        size_t times = 0;
+        for (AllocatorHooks *linked = AllocatorHooksDetail::first.load(); linked; linked = linked->next) {
+            times += linked == hooks;
+        }
+        return times;
+    }
+}
+
+TEST(AllocatorHooks, EveryEventReachesTheProfiler)
+{
+    counting.onAlloc = countAlloc;
+    counting.onFree = countFree;
+    counting.onSplit = countSplit;
+    counting.onCoalesce = countCoalesce;
+    counting.onGrow = countGrow;
+    counting.onTrim = countTrim;
+    events = Events();
+    registerHooks(&counting);
+
+    {
+        BuddyAllocator allocator(10);
+        allocator.mapLargeAllocations(512);
+
+        char *small = allocator.alloc(8);
+        char *large = allocator.alloc(600);
+        EXPECT_EQ(events.splits, allocator.stats().splits);
+        allocator.free(small);
+        allocator.free(large);
+        EXPECT_EQ(events.coalesces, allocator.stats().coalesces);
+
+        EXPECT_EQ(events.allocs, 2u);
+        EXPECT_EQ(events.frees, 2u);
+        EXPECT_EQ(events.grows, 2u);    // the arena and the mapping
+        EXPECT_EQ(events.trims, 1u);
+    }
+    EXPECT_EQ(events.trims, 2u);
+
+    // switched off, but still linked
+    unregisterHooks(&counting);
+    BuddyAllocator quiet(10);
+    quiet.free(quiet.alloc(8));
+    EXPECT_EQ(events.allocs, 2u);
+    EXPECT_EQ(timesLinked(&counting), 1u);
+}
+
+TEST(AllocatorHooks, QuaternaryEngineReportsItsSplitsAndCoalesces)
+{
+    static AllocatorHooks quarters;
+    quarters.onQuarterSplit = countQuarterSplit;
+    quarters.onQuarterCoalesce = countQuarterCoalesce;
+    events = Events();
+    registerHooks(&quarters);
+
+    QuaternaryEngine engine(12, 2);
+    uint64_t first = engine.alloc(2);
+    uint64_t second = engine.alloc(6);
+    EXPECT_EQ(events.splits, engine.splits());
+    engine.free(first);
+    engine.free(second);
+    EXPECT_EQ(events.coalesces, engine.coalesces());
+    EXPECT_GT(events.coalesces, 0u);
+
+    unregisterHooks(&quarters);
+}
+
+TEST(AllocatorHooks, RegisteringFromManyThreadsAtOnceLinksOnce)
+{
+    static AllocatorHooks contested;
+
+    for (int round = 0; round < 20; ++round) {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 8; ++t) {
+            threads.emplace_back([] { registerHooks(&contested); });
+        }
+        for (auto && thread : threads) {
+            thread.join();
+        }
+        unregisterHooks(&contested);
+    }
+
+    EXPECT_EQ(timesLinked(&contested), 1u);
+    EXPECT_FALSE(contested.active.load());
+}
+
+#endif
@@ -0,0 +1,261 @@
+#include "BuddyAllocator.h"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+TEST(BuddyAllocator, AllocatesAlignedBlocksOfTheRoundedSize)
+{
+    BuddyAllocator allocator(10);
+
+    char *small = allocator.alloc(5);
+    char *large = allocator.alloc(100);
+    EXPECT_TRUE(allocator.inArena(small));
+    EXPECT_EQ(allocator.blockSize(small), 8u);
+    EXPECT_EQ(allocator.blockSize(large), 128u);
+    EXPECT_EQ((large - allocator.base()) % 128, 0);
+
+    memset(large, 0x5a, 100);
+    allocator.free(small);
+    allocator.free(large);
+
+    BuddyAllocator::Stats stats = allocator.stats();
+    EXPECT_EQ(stats.liveBytes, 0u);
+    EXPECT_EQ(stats.largestFree, 1024u);
+}
+
+TEST(BuddyAllocator, ThrowsWhenFullAndTryAllocDoesNot)
+{
+    BuddyAllocator allocator(8);
+
+    char *all = allocator.alloc(256);
+    EXPECT_ANY_THROW(allocator.alloc(8));
+    EXPECT_EQ(allocator.tryAlloc(8), nullptr);
+    EXPECT_EQ(allocator.stats().failures, 2u);
+
+    allocator.free(all);
+    EXPECT_NE(allocator.tryAlloc(8), nullptr);
+}
+
+TEST(BuddyAllocator, StatsCountBlocksPerOrder)
+{
+    BuddyAllocator allocator(10);
+
+    char *a = allocator.alloc(16);
+    char *b = allocator.alloc(16);
+    char *c = allocator.alloc(64);
+
+    BuddyAllocator::Stats stats = allocator.stats();
+    EXPECT_EQ(stats.usedBlocks[4], 2u);
+    EXPECT_EQ(stats.usedBlocks[6], 1u);
+    EXPECT_EQ(stats.liveBytes, 96u);
+
+    allocator.free(a);
+    allocator.free(b);
+    allocator.free(c);
+    EXPECT_EQ(allocator.stats().usedBlocks[4], 0u);
+    EXPECT_EQ(allocator.stats().coalesces, allocator.stats().splits);
+}
+
+TEST(BuddyAllocator, StatsStayConsistentOverARandomTrace)
+{
+    // only the orders that changed are copied into the snapshot, so every order has to be right after any mix of calls
+    BuddyAllocator allocator(14);
+    std::mt19937 random(11);
+    std::vector<char*> live;
+
+    for (int i = 0; i < 4000; ++i) {
+        if (live.empty() || random() % 3) {
+            if (char *address = allocator.tryAlloc(uint16_t(1 + random() % 2000))) {
+                live.push_back(address);
+            }
+        } else {
+            size_t victim = random() % live.size();
+            allocator.free(live[victim]);
+            live[victim] = live.back();
+            live.pop_back();
+        }
+
+        BuddyAllocator::Stats stats = allocator.stats();
+        uint64_t freeBytes = 0;
+        uint32_t largest = 0;
+        for (int k = 0; k <= BuddyAllocator::MaxOrder; ++k) {
+            freeBytes += uint64_t(stats.freeBlocks[k]) << k;
+            largest = stats.freeBlocks[k] ? 1u << k : largest;
+        }
+        ASSERT_EQ(freeBytes + stats.liveBytes, allocator.capacity());
+        ASSERT_EQ(largest, stats.largestFree);
+    }
+
+    for (char *address : live) {
+        allocator.free(address);
+    }
+    EXPECT_EQ(allocator.stats().freeBlocks[14], 1u);
+}
+
+TEST(BuddyAllocator, FreeingNullDoesNothing)
+{
+    BuddyAllocator allocator(8);
+    char *block = allocator.alloc(8);
+
+    EXPECT_NO_THROW(allocator.free(nullptr));
+    char *batch[] = { nullptr, block, nullptr };
+    EXPECT_NO_THROW(allocator.freeBatch(batch, 3));
+    EXPECT_EQ(allocator.stats().liveBytes, 0u);
+}
+
+TEST(BuddyAllocator, AllocNearStaysInTheParentBlock)
+{
+    BuddyAllocator allocator(12);
+
+    char *first = allocator.alloc(64);
+    char *second = allocator.alloc(512);
+    char *near = allocator.allocNear(64, first, 9);
+    EXPECT_EQ((near - allocator.base()) >> 9, (first - allocator.base()) >> 9);
+
+    allocator.free(first);
+    allocator.free(second);
+    allocator.free(near);
+}
+
+TEST(BuddyAllocator, FreeingForeignMemoryThrows)
+{
+    BuddyAllocator allocator(8);
+    char outside[16];
+    EXPECT_ANY_THROW(allocator.free(outside));
+}
+
+TEST(BuddyAllocator, AllocNearFallsBackWhenTheParentIsFull)
+{
+    BuddyAllocator allocator(12);
+
+    char *group = allocator.alloc(256);
+    allocator.measureLatency(true);
+    EXPECT_EQ(allocator.tryAllocNear(8, group, 8), nullptr);
+
+    // a miss is no failure, since the caller has somewhere else to go, but it is counted and timed
+    BuddyAllocator::Stats stats = allocator.stats();
+    EXPECT_EQ(stats.nearMisses, 1u);
+    EXPECT_EQ(stats.failures, 0u);
+    uint64_t timed = 0;
+    for (uint64_t count : stats.latency) {
+        timed += count;
+    }
+    EXPECT_EQ(timed, 1u);
+
+    char *elsewhere = allocator.allocNear(8, group, 8);
+    EXPECT_NE(elsewhere, nullptr);
+    EXPECT_NE((elsewhere - allocator.base()) >> 8, (group - allocator.base()) >> 8);
+
+    allocator.free(group);
+    allocator.free(elsewhere);
+}
+
+TEST(BuddyAllocator, LargeAllocationsAreMappedOutsideTheArena)
+{
+    BuddyAllocator allocator(12);
+    allocator.mapLargeAllocations(1024);
+
+    char *small = allocator.alloc(512);
+    char *large = allocator.alloc(2048);
+    EXPECT_TRUE(allocator.inArena(small));
+    EXPECT_FALSE(allocator.inArena(large));
+    EXPECT_EQ(allocator.stats().largestFree, 2048u);
+    EXPECT_GE(allocator.stats().mappedBytes, 2048u);
+
+    allocator.free(large);
+    allocator.free(small);
+    EXPECT_EQ(allocator.stats().mappedBytes, 0u);
+    EXPECT_EQ(allocator.stats().largestFree, 4096u);
+}
+
+TEST(BuddyAllocator, ReallocResizesInPlaceAndGrowsMappingsWithoutCopying)
+{
+    BuddyAllocator allocator(12);
+    allocator.mapLargeAllocations(1024);
+
+    // inside its block nothing moves
+    char *block = allocator.realloc(nullptr, 100);
+    EXPECT_EQ(allocator.realloc(block, 128), block);
+
+    // past the block it moves, contents included
+    memset(block, 7, 128);
+    char *moved = allocator.realloc(block, 300);
+    EXPECT_NE(moved, block);
+    EXPECT_EQ(allocator.blockSize(moved), 512u);
+    EXPECT_EQ(moved[127], 7);
+
+    // past the threshold it is mapped, and from then on grows far beyond what alloc could ask for
+    char *mapped = allocator.realloc(moved, 2000);
+    EXPECT_FALSE(allocator.inArena(mapped));
+    EXPECT_EQ(mapped[127], 7);
+    mapped = allocator.realloc(mapped, size_t(16) << 20);
+    ASSERT_NE(mapped, nullptr);
+    EXPECT_EQ(mapped[127], 7);
+    mapped[(size_t(16) << 20) - 1] = 1;
+    EXPECT_GE(allocator.stats().mappedBytes, size_t(16) << 20);
+    EXPECT_EQ(allocator.stats().largestFree, 4096u);
+
+    EXPECT_EQ(allocator.realloc(mapped, 0), nullptr);
+    EXPECT_EQ(allocator.stats().mappedBytes, 0u);
+}
+
+TEST(BuddyAllocator, FailedReallocKeepsTheBlock)
+{
+    BuddyAllocator allocator(12);
+
+    char *half = allocator.alloc(2048);
+    char *other = allocator.alloc(1024);
+    half[0] = 3;
+
+    // the arena has no 4K block to move to, and nothing says to map it
+    EXPECT_EQ(allocator.realloc(half, 4096), nullptr);
+    EXPECT_EQ(half[0], 3);
+
+    allocator.free(other);
+    allocator.free(half);
+}
+
+TEST(BuddyAllocator, AllocGroupAlignsEveryPartInOneBlock)
+{
+    BuddyAllocator allocator(12);
+
+    const uint16_t sizes[] = { 10, 3, 100, 1 };
+    const uint16_t aligns[] = { 8, 1, 64, 2 };
+    char *parts[4];
+    char *group = allocator.allocGroup(sizes, aligns, 4, parts);
+
+    EXPECT_EQ(parts[0], group);
+    EXPECT_EQ(parts[1], group + 10);
+    EXPECT_EQ(parts[2], group + 64);
+    EXPECT_EQ(parts[3], group + 164);
+    EXPECT_EQ(uintptr_t(parts[2]) % 64, 0u);
+    EXPECT_EQ(allocator.blockSize(group), 256u);
+
+    allocator.free(group);
+    EXPECT_EQ(allocator.stats().largestFree, 4096u);
+}
+
+TEST(BuddyAllocator, AllocGroupRejectsWhatItCannotAlign)
+{
+    BuddyAllocator allocator(12);
+    allocator.mapLargeAllocations(1024);
+    char *parts[2];
+
+    const uint16_t odd[] = { 8, 24 };
+    EXPECT_ANY_THROW(allocator.allocGroup(odd, odd, 2, parts));
+
+    // mapped, where only 16 byte alignment can be had
+    const uint16_t sizes[] = { 16, 2000 };
+    const uint16_t loose[] = { 16, 16 };
+    const uint16_t strict[] = { 16, 64 };
+    EXPECT_ANY_THROW(allocator.allocGroup(sizes, strict, 2, parts));
+
+    char *group = allocator.allocGroup(sizes, loose, 2, parts);
+    EXPECT_FALSE(allocator.inArena(group));
+    EXPECT_EQ(uintptr_t(parts[1]) % 16, 0u);
+    allocator.free(group);
+}
@@ -0,0 +1,159 @@
+#include "BuddyEngine.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+TEST(BuddyEngine, SplitsAndCoalescesBackToOneBlock)
+{
+    BuddyEngine engine(10, 3);
+
+    uint64_t a = engine.alloc(3);
+    uint64_t b = engine.alloc(3);
+    ASSERT_NE(a, BuddyEngine::None);
+    ASSERT_NE(b, BuddyEngine::None);
+    EXPECT_EQ(a ^ b, 8u);                           // buddies of each other
+    EXPECT_EQ(engine.splits(), 7u);                 // 2^10 down to 2^3
+
+    EXPECT_EQ(engine.free(a), 3);
+    EXPECT_EQ(engine.free(b), 3);
+    EXPECT_EQ(engine.coalesces(), 7u);
+    EXPECT_EQ(engine.largestFree(), 10);
+    EXPECT_EQ(engine.freeBlocks(10), 1u);
+}
+
+TEST(BuddyEngine, RoundsUpToMinOrderAndFailsWhenFull)
+{
+    BuddyEngine engine(6, 3);
+
+    for (int i = 0; i < 8; ++i) {
+        uint64_t offset = engine.alloc(0);
+        ASSERT_NE(offset, BuddyEngine::None);
+        EXPECT_EQ(engine.orderOf(offset), 3);
+    }
+    EXPECT_EQ(engine.alloc(3), BuddyEngine::None);
+    EXPECT_EQ(engine.alloc(7), BuddyEngine::None);
+    EXPECT_EQ(engine.largestFree(), -1);
+}
+
+TEST(BuddyEngine, AllocAtReservesThatBlockOnly)
+{
+    BuddyEngine engine(8, 3);
+
+    EXPECT_TRUE(engine.allocAt(64, 5));
+    EXPECT_FALSE(engine.allocAt(64, 3));            // taken
+    EXPECT_FALSE(engine.allocAt(0, 7));             // contains the block at 64
+    EXPECT_FALSE(engine.allocAt(4, 3));             // misaligned
+    EXPECT_TRUE(engine.allocAt(96, 5));
+
+    engine.free(64);
+    engine.free(96);
+    EXPECT_EQ(engine.largestFree(), 8);
+}
+
+TEST(BuddyEngine, AllocWithinStaysInTheRegion)
+{
+    BuddyEngine engine(12, 3);
+
+    uint64_t first = engine.allocWithin(4, 2048, 10);
+    ASSERT_NE(first, BuddyEngine::None);
+    EXPECT_GE(first, 2048u);
+    EXPECT_LT(first, 3072u);
+
+    for (int i = 0; i < 63; ++i) {
+        uint64_t offset = engine.allocWithin(4, 2048, 10);
+        ASSERT_NE(offset, BuddyEngine::None);
+        EXPECT_EQ(offset >> 10, 2u);
+    }
+    EXPECT_EQ(engine.allocWithin(4, 2048, 10), BuddyEngine::None);
+    EXPECT_NE(engine.alloc(4), BuddyEngine::None);
+}
+
+TEST(BuddyEngine, FreeingAFreeBlockThrows)
+{
+    BuddyEngine engine(8, 3);
+    uint64_t offset = engine.alloc(3);
+    engine.free(offset);
+    EXPECT_ANY_THROW(engine.free(offset));
+}
+
+TEST(BuddyEngine, FreeingAnAbsorbedBuddyThrows)
+{
+    BuddyEngine engine(8, 3);
+    uint64_t a = engine.alloc(3);
+    uint64_t b = engine.alloc(3);
+    ASSERT_EQ(a ^ b, 8u);
+
+    // b was merged into a's block, and still carries the tag it had while reserved
+    engine.free(a);
+    engine.free(b);
+    EXPECT_ANY_THROW(engine.free(b));
+    EXPECT_ANY_THROW(engine.free(a));
+    EXPECT_EQ(engine.largestFree(), 8);
+    EXPECT_EQ(engine.freeBlocks(8), 1u);
+}
+
+TEST(BuddyEngine, FreeingOutsideTheRangeOrInsideAUnitThrows)
+{
+    BuddyEngine engine(8, 3);
+    uint64_t offset = engine.alloc(3);
+    EXPECT_ANY_THROW(engine.free(256));
+    EXPECT_ANY_THROW(engine.free(BuddyEngine::None));
+    EXPECT_ANY_THROW(engine.free(offset + 4));
+    engine.free(offset);
+}
+
+TEST(BuddyEngine, RestoreRebuildsTheFreeLists)
+{
+    BuddyEngine engine(10, 3);
+    std::vector<uint64_t> live;
+    for (uint8_t k = 3; k < 8; ++k) {
+        live.push_back(engine.alloc(k));
+    }
+
+    BuddyEngine copy(10, 3);
+    copy.restore(engine.tags());
+    for (int k = 0; k <= 10; ++k) {
+        EXPECT_EQ(copy.freeBlocks(uint8_t(k)), engine.freeBlocks(uint8_t(k)));
+    }
+
+    for (uint64_t offset : live) {
+        copy.free(offset);
+    }
+    EXPECT_EQ(copy.largestFree(), 10);
+}
+
+TEST(BuddyEngine, RandomTraceNeverOverlaps)
+{
+    BuddyEngine engine(16, 3);
+    std::mt19937 random(1);
+    std::vector<std::pair<uint64_t, uint8_t>> live;
+
+    for (int i = 0; i < 20000; ++i) {
+        if (live.empty() || random() % 3) {
+            uint8_t k = uint8_t(3 + random() % 8);
+            uint64_t offset = engine.alloc(k);
+            if (offset != BuddyEngine::None) {
+                EXPECT_EQ(offset & ((uint64_t(1) << k) - 1), 0u);
+                live.emplace_back(offset, k);
+            }
+        } else {
+            size_t victim = random() % live.size();
+            EXPECT_EQ(engine.free(live[victim].first), live[victim].second);
+            live[victim] = live.back();
+            live.pop_back();
+        }
+    }
+
+    std::sort(live.begin(), live.end());
+    for (size_t i = 1; i < live.size(); ++i) {
+        EXPECT_LE(live[i - 1].first + (uint64_t(1) << live[i - 1].second), live[i].first);
+    }
+
+    for (auto && block : live) {
+        engine.free(block.first);
+    }
+    EXPECT_EQ(engine.largestFree(), 16);
+}
@@ -0,0 +1,97 @@
+#include "DeferredReclaimer.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+TEST(DeferredReclaimer, FreesEverythingHandedOff)
+{
+    BuddyAllocator heap(12);
+    LockedAllocator allocator(heap);
+    DeferredReclaimer reclaimer(allocator, heap.capacity());
+
+    {
+        DeferredReclaimer::Local local(reclaimer);
+        for (int i = 0; i < 300; ++i) {
+            local.freeDeferred(allocator.alloc(8));
+        }
+        // a full batch went on its own, the other 44 only once flushed
+        reclaimer.drain();
+        EXPECT_LT(heap.stats().largestFree, 4096u);
+    }
+
+    // the Local flushed on the way out
+    reclaimer.drain();
+    EXPECT_EQ(reclaimer.outstanding(), 0u);
+    EXPECT_EQ(heap.stats().largestFree, 4096u);
+}
+
+TEST(DeferredReclaimer, BatchesBiggerThanTheBoundStillGoThrough)
+{
+    BuddyAllocator heap(12);
+    LockedAllocator allocator(heap);
+    DeferredReclaimer reclaimer(allocator, 64);
+
+    DeferredReclaimer::Local local(reclaimer);
+    for (int round = 0; round < 4; ++round) {
+        for (int i = 0; i < 16; ++i) {
+            local.freeDeferred(allocator.alloc(64));
+        }
+        local.flush();
+    }
+
+    reclaimer.drain();
+    EXPECT_EQ(heap.stats().largestFree, 4096u);
+}
+
+TEST(DeferredReclaimer, ManyThreadsDeferringAtOnce)
+{
+    BuddyAllocator heap(14);
+    LockedAllocator allocator(heap);
+    DeferredReclaimer reclaimer(allocator, 2048);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            DeferredReclaimer::Local local(reclaimer);
+            for (int i = 0; i < 2000; ++i) {
+                char *address = nullptr;
+                while (!address) {
+                    try {
+                        address = allocator.alloc(16);
+                    } catch (const char *) {
+                        // everything is handed off, the reclaimer just has not got to it
+                        local.flush();
+                        std::this_thread::yield();
+                    }
+                }
+                local.freeDeferred(address);
+            }
+        });
+    }
+    for (auto && thread : threads) {
+        thread.join();
+    }
+
+    reclaimer.drain();
+    EXPECT_EQ(reclaimer.outstanding(), 0u);
+    EXPECT_EQ(heap.stats().largestFree, 16384u);
+}
+
+TEST(DeferredReclaimer, DestructionFreesWhatIsOutstanding)
+{
+    BuddyAllocator heap(12);
+    LockedAllocator allocator(heap);
+
+    {
+        DeferredReclaimer reclaimer(allocator, heap.capacity());
+        DeferredReclaimer::Local local(reclaimer);
+        for (int i = 0; i < 64; ++i) {
+            local.freeDeferred(allocator.alloc(32));
+        }
+        local.flush();
+    }
+
+    EXPECT_EQ(heap.stats().largestFree, 4096u);
+}
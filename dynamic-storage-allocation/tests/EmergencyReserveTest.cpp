@@ -0,0 +1,109 @@
+#include "EmergencyReserve.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace
+{
+    // bulk traffic takes 64 byte blocks until the heap has nothing left
+    std::vector<char*> exhaust(EmergencyReserve &reserve)
+    {
+        std::vector<char*> bulk;
+        while (true) {
+            try {
+                bulk.push_back(reserve.alloc(64));
+            } catch (const char *) {
+                return bulk;
+            }
+        }
+    }
+}
+
+TEST(EmergencyReserve, CriticalAllocationsSucceedWhileBulkFails)
+{
+    BuddyAllocator heap(12);
+    EmergencyReserve reserve(heap);
+    reserve.reserve(5, 2);
+    reserve.reserve(8, 1);
+
+    std::vector<char*> bulk = exhaust(reserve);
+    EXPECT_EQ(bulk.size(), (4096u - 2 * 32 - 256) / 64);
+    EXPECT_ANY_THROW(reserve.alloc(8));
+
+    // the reserve serves these, smallest fitting block first
+    char *first = reserve.allocCritical(20);
+    char *second = reserve.allocCritical(32);
+    char *third = reserve.allocCritical(8);
+    EXPECT_EQ(heap.blockSize(first), 32u);
+    EXPECT_EQ(heap.blockSize(second), 32u);
+    EXPECT_EQ(heap.blockSize(third), 256u);
+    EXPECT_EQ(reserve.counters().reserveHits, 3u);
+
+    EXPECT_ANY_THROW(reserve.allocCritical(8));
+    EXPECT_EQ(reserve.counters().exhausted, 1u);
+    EXPECT_ANY_THROW(reserve.alloc(8));
+
+    reserve.free(first);
+    reserve.free(second);
+    reserve.free(third);
+    for (char *block : bulk) {
+        reserve.free(block);
+    }
+}
+
+TEST(EmergencyReserve, FreesRefillTheReserve)
+{
+    BuddyAllocator heap(12);
+    EmergencyReserve reserve(heap);
+    reserve.reserve(6, 2);
+
+    std::vector<char*> bulk = exhaust(reserve);
+    char *critical = reserve.allocCritical(64);
+    EXPECT_EQ(reserve.available(6), 1u);
+
+    // the first bulk free makes room for exactly the block the reserve is missing
+    reserve.free(bulk.back());
+    bulk.pop_back();
+    EXPECT_EQ(reserve.available(6), 2u);
+    EXPECT_EQ(reserve.counters().refills, 3u);
+
+    reserve.free(critical);
+    for (char *block : bulk) {
+        reserve.free(block);
+    }
+}
+
+TEST(EmergencyReserve, FreesThatCannotHelpDoNotCountAsFailures)
+{
+    BuddyAllocator heap(12);
+    EmergencyReserve reserve(heap);
+    reserve.reserve(10, 1);
+
+    std::vector<char*> bulk = exhaust(reserve);
+    reserve.allocCritical(1024);
+    uint64_t failures = heap.stats().failures;
+
+    // freeing every other block never leaves a free 1K block, so the reserve must not even try
+    for (size_t i = 0; i < bulk.size(); i += 2) {
+        reserve.free(bulk[i]);
+    }
+    EXPECT_EQ(heap.stats().failures, failures);
+    EXPECT_EQ(reserve.available(10), 0u);
+
+    for (size_t i = 1; i < bulk.size(); i += 2) {
+        reserve.free(bulk[i]);
+    }
+    EXPECT_EQ(reserve.available(10), 1u);
+    EXPECT_EQ(heap.stats().failures, failures);
+}
+
+TEST(EmergencyReserve, OrdersBeyondTheArenaAreRejected)
+{
+    BuddyAllocator heap(10);
+    EmergencyReserve reserve(heap);
+
+    EXPECT_ANY_THROW(reserve.reserve(11, 1));
+    EXPECT_NO_THROW(reserve.reserve(10, 1));
+    EXPECT_EQ(reserve.available(10), 1u);
+}
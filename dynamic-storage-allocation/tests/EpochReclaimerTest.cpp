@@ -0,0 +1,126 @@
+#include "EpochReclaimer.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // retires a batch of throwaway blocks, so that the next pin tries to move the epoch along
+    void advance(EpochReclaimer::Participant &advancer, LockedAllocator &allocator)
+    {
+        advancer.pin();
+        for (size_t i = 0; i < EpochReclaimer::BatchSize; ++i) {
+            advancer.retire(allocator.alloc(8));
+        }
+        advancer.unpin();
+
+        advancer.pin();
+        advancer.unpin();
+    }
+}
+
+TEST(EpochReclaimer, NodesOutliveReadersThatPinnedAfterTheRetirerDid)
+{
+    BuddyAllocator heap(16);
+    LockedAllocator allocator(heap);
+    EpochReclaimer reclaimer(allocator);
+    EpochReclaimer::Participant retirer(reclaimer), reader(reclaimer), advancer(reclaimer);
+
+    char *node = allocator.alloc(16);
+    uint64_t e = reclaimer.epoch();
+
+    // the retirer pins in e, then the epoch moves on to e + 1 and the reader pins there and finds the node
+    retirer.pin();
+    advance(advancer, allocator);
+    ASSERT_EQ(reclaimer.epoch(), e + 1);
+    reader.pin();
+
+    // the retirer, still pinned in e, unlinks and retires it
+    retirer.retire(node);
+    retirer.unpin();
+
+    // e + 2 is reached, but the reader holds the epoch there
+    advance(advancer, allocator);
+    ASSERT_EQ(reclaimer.epoch(), e + 2);
+    advance(advancer, allocator);
+    ASSERT_EQ(reclaimer.epoch(), e + 2);
+
+    uint64_t reclaimed = reclaimer.reclaimed();
+    retirer.pin();
+    retirer.unpin();
+    EXPECT_EQ(reclaimer.reclaimed(), reclaimed) << "freed under a reader still holding it";
+
+    // once the reader is done the epoch can reach e + 3, and the node goes back to the heap. The advancer still has
+    // its last batch, so pinning is enough
+    reader.unpin();
+    advancer.pin();
+    advancer.unpin();
+    ASSERT_EQ(reclaimer.epoch(), e + 3);
+
+    reclaimed = reclaimer.reclaimed();
+    retirer.pin();
+    retirer.unpin();
+    EXPECT_EQ(reclaimer.reclaimed(), reclaimed + 1);
+}
+
+TEST(EpochReclaimer, OrphansWaitForTheirEpochToo)
+{
+    BuddyAllocator heap(16);
+    LockedAllocator allocator(heap);
+    EpochReclaimer reclaimer(allocator);
+    EpochReclaimer::Participant reader(reclaimer), advancer(reclaimer);
+
+    char *node = allocator.alloc(16);
+    uint64_t e = reclaimer.epoch();
+    uint64_t reclaimed;
+
+    {
+        EpochReclaimer::Participant retirer(reclaimer);
+        retirer.pin();
+        advance(advancer, allocator);
+        reader.pin();
+
+        retirer.retire(node);
+        retirer.unpin();
+        reclaimed = reclaimer.reclaimed();
+    }
+
+    // the retirer's limbo is left with the reclaimer; reaching e + 2 must not free it while the reader is pinned
+    advance(advancer, allocator);
+    ASSERT_EQ(reclaimer.epoch(), e + 2);
+    EXPECT_EQ(reclaimer.reclaimed(), reclaimed + EpochReclaimer::BatchSize);
+
+    reader.unpin();
+    advance(advancer, allocator);
+    ASSERT_EQ(reclaimer.epoch(), e + 3);
+    EXPECT_EQ(reclaimer.reclaimed(), reclaimed + 2 * EpochReclaimer::BatchSize + 1);
+}
+
+TEST(EpochReclaimer, EverythingRetiredIsFreedInTheEnd)
+{
+    BuddyAllocator heap(16);
+    LockedAllocator allocator(heap);
+
+    {
+        EpochReclaimer reclaimer(allocator);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            // few enough that the heap holds them all, should a preempted thread hold the epoch back throughout
+            threads.emplace_back([&] {
+                EpochReclaimer::Participant self(reclaimer);
+                for (int i = 0; i < 1000; ++i) {
+                    EpochReclaimer::Guard guard(self);
+                    self.retire(allocator.alloc(8));
+                }
+            });
+        }
+        for (auto && thread : threads) {
+            thread.join();
+        }
+        EXPECT_GT(reclaimer.epoch(), 2u);
+    }
+
+    EXPECT_EQ(heap.stats().largestFree, heap.capacity());
+}
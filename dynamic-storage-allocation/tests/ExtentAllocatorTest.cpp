@@ -0,0 +1,138 @@
+#include "ExtentAllocator.h"
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+    struct ExtentFiles
+    {
+        std::string path = "/tmp/extents." + std::to_string(getpid());
+
+        ExtentFiles() { clear(); }
+        ~ExtentFiles() { clear(); }
+
+        void clear()
+        {
+            remove((path + ".bitmap").c_str());
+            remove((path + ".journal").c_str());
+        }
+    };
+
+    // runs work in a child, which has to end in crash() so that nothing but what was synced survives
+    template <typename Work>
+    void inChild(Work work)
+    {
+        pid_t child = fork();
+        if (child == 0) {
+            work();
+            _exit(1);
+        }
+
+        int status = 0;
+        waitpid(child, &status, 0);
+        ASSERT_TRUE(WIFEXITED(status));
+        ASSERT_EQ(WEXITSTATUS(status), 0);
+    }
+
+    void crash()
+    {
+        _exit(0);
+    }
+}
+
+TEST(ExtentAllocator, ExtentsSurviveReopening)
+{
+    ExtentFiles files;
+    uint64_t a, b;
+
+    {
+        ExtentAllocator extents(files.path, 20, 12);
+        a = extents.alloc(4096);
+        b = extents.alloc(100000);
+        extents.free(extents.alloc(8192));
+    }
+
+    ExtentAllocator extents(files.path, 20, 12);
+    EXPECT_FALSE(extents.engine().isFree(a));
+    EXPECT_FALSE(extents.engine().isFree(b));
+    EXPECT_EQ(extents.engine().orderOf(b), 17);
+
+    extents.free(a);
+    extents.free(b);
+    EXPECT_EQ(extents.engine().largestFree(), 20);
+}
+
+TEST(ExtentAllocator, CrashKeepsOnlyWhatWasSynced)
+{
+    ExtentFiles files;
+    uint64_t durable = BuddyEngine::None;
+
+    // the child hands out the same offsets this process would, so they can be predicted
+    {
+        BuddyEngine engine(20, 12);
+        durable = engine.alloc(12);
+    }
+
+    inChild([&] {
+        ExtentAllocator extents(files.path, 20, 12);
+        extents.alloc(4096);
+        extents.sync();
+        extents.alloc(4096);        // never synced
+        crash();
+    });
+
+    ExtentAllocator extents(files.path, 20, 12);
+    EXPECT_FALSE(extents.engine().isFree(durable));
+    EXPECT_EQ(extents.engine().freeBlocks(12), 1u);     // the lost extent's buddy is free again
+}
+
+TEST(ExtentAllocator, TornJournalTailIsDropped)
+{
+    ExtentFiles files;
+    uint64_t offset;
+
+    {
+        ExtentAllocator extents(files.path, 20, 12);
+        offset = extents.alloc(4096);
+    }
+
+    // half a record at the end, as a crash mid-write would leave
+    int journal = open((files.path + ".journal").c_str(), O_WRONLY | O_APPEND);
+    ASSERT_GE(journal, 0);
+    char garbage[13] = "not a record";
+    ASSERT_EQ(write(journal, garbage, sizeof(garbage)), ssize_t(sizeof(garbage)));
+    close(journal);
+
+    ExtentAllocator extents(files.path, 20, 12);
+    EXPECT_FALSE(extents.engine().isFree(offset));
+    extents.free(offset);
+    EXPECT_EQ(extents.engine().largestFree(), 20);
+}
+
+TEST(ExtentAllocator, CheckpointFoldsTheJournalIn)
+{
+    ExtentFiles files;
+    std::vector<uint64_t> live;
+
+    {
+        ExtentAllocator extents(files.path, 24, 12);
+        for (int i = 0; i < 1000; ++i) {
+            live.push_back(extents.alloc(4096));
+        }
+        extents.checkpoint();
+        extents.free(live.back());
+        live.pop_back();
+    }
+
+    ExtentAllocator extents(files.path, 24, 12);
+    for (uint64_t offset : live) {
+        EXPECT_FALSE(extents.engine().isFree(offset));
+        extents.free(offset);
+    }
+    EXPECT_EQ(extents.engine().largestFree(), 24);
+}
@@ -0,0 +1,52 @@
+#include "BuddyAllocator.h"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+TEST(GuardPages, OnlyLargeAllocationsAreMapped)
+{
+    BuddyAllocator allocator(12);
+    allocator.guardLargeAllocations(512);
+
+    char *small = allocator.alloc(511);
+    char *large = allocator.alloc(512);
+    EXPECT_TRUE(allocator.inArena(small));
+    EXPECT_FALSE(allocator.inArena(large));
+    EXPECT_EQ(allocator.blockSize(large), 512u);
+    EXPECT_GT(allocator.stats().mappedBytes, 512u);
+
+    memset(large, 1, 512);
+    allocator.free(large);
+    allocator.free(small);
+    EXPECT_EQ(allocator.stats().mappedBytes, 0u);
+
+    allocator.guardLargeAllocations(0);
+    large = allocator.alloc(512);
+    EXPECT_TRUE(allocator.inArena(large));
+    allocator.free(large);
+}
+
+TEST(GuardPages, GuardAfterEndsFlushAgainstIt)
+{
+    BuddyAllocator allocator(12);
+    allocator.guardLargeAllocations(1024, GuardPlacement::After);
+
+    char *buffer = allocator.alloc(1024);
+    memset(buffer, 1, 1024);
+    EXPECT_DEATH(buffer[1024] = 1, "");
+
+    allocator.free(buffer);
+}
+
+TEST(GuardPages, GuardBeforeCatchesUnderruns)
+{
+    BuddyAllocator allocator(12);
+    allocator.guardLargeAllocations(1024, GuardPlacement::Before);
+
+    char *buffer = allocator.alloc(1024);
+    memset(buffer, 1, 1024);
+    EXPECT_DEATH(buffer[-1] = 1, "");
+
+    allocator.free(buffer);
+}
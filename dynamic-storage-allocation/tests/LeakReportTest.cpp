@@ -0,0 +1,99 @@
+#include "BuddyAllocator.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+namespace
+{
+    std::string addressOf(const char *address)
+    {
+        std::ostringstream out;
+        out << (const void*)address;
+        return out.str();
+    }
+}
+
+TEST(LeakReport, NothingToReportOnACleanHeap)
+{
+    BuddyAllocator allocator(10);
+    allocator.free(allocator.alloc(16));
+
+    std::ostringstream out;
+    EXPECT_EQ(allocator.reportLeaks(out), 0u);
+    EXPECT_TRUE(out.str().empty());
+}
+
+TEST(LeakReport, ListsLeakedBlocksByOrder)
+{
+    BuddyAllocator allocator(12);
+
+    char *small = allocator.alloc(9);           // 16 bytes
+    char *other = allocator.alloc(16);          // 16 bytes
+    char *large = allocator.alloc(200);         // 256 bytes
+    allocator.free(allocator.alloc(64));        // not a leak
+
+    std::ostringstream out;
+    EXPECT_EQ(allocator.reportLeaks(out), 3u);
+
+    std::string report = out.str();
+    EXPECT_NE(report.find("3 block(s) still reserved, 288 bytes"), std::string::npos) << report;
+
+    size_t sixteen = report.find("   2 x 16 bytes:");
+    size_t twoFiftySix = report.find("   1 x 256 bytes:");
+    ASSERT_NE(sixteen, std::string::npos) << report;
+    ASSERT_NE(twoFiftySix, std::string::npos) << report;
+    EXPECT_LT(twoFiftySix, sixteen);            // largest order first
+    EXPECT_EQ(report.find(" x 64 bytes"), std::string::npos);
+
+    std::string line = report.substr(sixteen, report.find('\n', sixteen) - sixteen);
+    EXPECT_NE(line.find(addressOf(small)), std::string::npos) << line;
+    EXPECT_NE(line.find(addressOf(other)), std::string::npos) << line;
+    EXPECT_EQ(line.find(addressOf(large)), std::string::npos) << line;
+
+    allocator.free(small);
+    allocator.free(other);
+    allocator.free(large);
+
+    std::ostringstream after;
+    EXPECT_EQ(allocator.reportLeaks(after), 0u);
+}
+
+TEST(LeakReport, IncludesMappedAllocations)
+{
+    BuddyAllocator allocator(12);
+    allocator.guardLargeAllocations(1024);
+
+    char *guarded = allocator.alloc(2000);
+    char *small = allocator.alloc(8);
+
+    std::ostringstream out;
+    EXPECT_EQ(allocator.reportLeaks(out), 2u);
+    EXPECT_NE(out.str().find("1 mapped: " + addressOf(guarded) + " (2000 bytes)"), std::string::npos) << out.str();
+    EXPECT_NE(out.str().find("1 x 8 bytes: " + addressOf(small)), std::string::npos) << out.str();
+
+    allocator.free(guarded);
+    allocator.free(small);
+}
+
+TEST(LeakReport, PrintedAtDestructionWhenAskedFor)
+{
+    std::string leaked;
+
+    testing::internal::CaptureStderr();
+    {
+        BuddyAllocator allocator(10);
+        allocator.reportLeaksOnDestruction(true);
+        leaked = addressOf(allocator.alloc(32));
+    }
+    std::string report = testing::internal::GetCapturedStderr();
+
+    EXPECT_NE(report.find("1 x 32 bytes: " + leaked), std::string::npos) << report;
+
+    testing::internal::CaptureStderr();
+    {
+        BuddyAllocator allocator(10);
+        allocator.alloc(32);
+    }
+    EXPECT_TRUE(testing::internal::GetCapturedStderr().empty());
+}
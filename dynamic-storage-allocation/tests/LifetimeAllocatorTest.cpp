@@ -0,0 +1,90 @@
+#include "LifetimeAllocator.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+TEST(LifetimeAllocator, LongLivedBlocksArePackedTogether)
+{
+    BuddyAllocator heap(12);
+    LifetimeAllocator allocator(heap);
+
+    // short-lived traffic in between would normally take the space right next to the first long-lived block
+    char *first = allocator.alloc(16, LifetimeAllocator::Lifetime::Long);
+    char *shortLived = allocator.alloc(16, LifetimeAllocator::Lifetime::Short);
+    char *second = allocator.alloc(32, LifetimeAllocator::Lifetime::Long);
+    char *third = allocator.alloc(16, LifetimeAllocator::Lifetime::Long);
+
+    EXPECT_EQ((first - heap.base()) >> 8, (second - heap.base()) >> 8);
+    EXPECT_EQ((first - heap.base()) >> 8, (third - heap.base()) >> 8);
+    EXPECT_EQ(allocator.counters().shortAllocs, 1u);
+    EXPECT_EQ(allocator.counters().longAllocs, 3u);
+    EXPECT_EQ(allocator.counters().predictedLong, 0u);
+    EXPECT_EQ(allocator.counters().regions, 1u);
+
+    allocator.free(shortLived);
+    allocator.free(first);
+    allocator.free(second);
+    allocator.free(third);
+    EXPECT_EQ(allocator.fragmentation(), 0.0);
+}
+
+TEST(LifetimeAllocator, LearnsLongLivedSites)
+{
+    BuddyAllocator heap(12);
+    LifetimeAllocator allocator(heap, 4);
+
+    // one call site whose blocks outlive 4 further allocations: the first one is placed as short-lived, after that the
+    // site is predicted long-lived
+    for (int round = 0; round < 3; ++round) {
+        char *held = allocator.alloc(16);
+        EXPECT_EQ(allocator.counters().longAllocs, uint64_t(round));
+        EXPECT_EQ(allocator.counters().predictedLong, uint64_t(round));
+
+        std::vector<char*> churn;
+        for (int i = 0; i < 8; ++i) {
+            churn.push_back(allocator.alloc(16, LifetimeAllocator::Lifetime::Short));
+        }
+        for (char *address : churn) {
+            allocator.free(address);
+        }
+        allocator.free(held);
+    }
+}
+
+TEST(LifetimeAllocator, AFullRegionStartsAnother)
+{
+    BuddyAllocator heap(12);
+    LifetimeAllocator allocator(heap);
+
+    // two 128 byte blocks fill a 256 byte region
+    char *blocks[3];
+    for (char *&block : blocks) {
+        block = allocator.alloc(128, LifetimeAllocator::Lifetime::Long);
+    }
+    EXPECT_EQ((blocks[0] - heap.base()) >> 8, (blocks[1] - heap.base()) >> 8);
+    EXPECT_NE((blocks[0] - heap.base()) >> 8, (blocks[2] - heap.base()) >> 8);
+    EXPECT_EQ(allocator.counters().regions, 2u);
+
+    // and a block of a whole region has nothing to be packed with
+    char *whole = allocator.alloc(256, LifetimeAllocator::Lifetime::Long);
+    EXPECT_EQ(allocator.counters().regions, 2u);
+
+    allocator.free(whole);
+    for (char *block : blocks) {
+        allocator.free(block);
+    }
+}
+
+TEST(LifetimeAllocator, FreesMappedBlocks)
+{
+    BuddyAllocator heap(12);
+    heap.mapLargeAllocations(1024);
+    LifetimeAllocator allocator(heap);
+
+    char *mapped = allocator.alloc(4096, LifetimeAllocator::Lifetime::Long);
+    EXPECT_FALSE(heap.inArena(mapped));
+    mapped[4095] = 1;
+    allocator.free(mapped);
+    EXPECT_EQ(heap.stats().largestFree, 4096u);
+}
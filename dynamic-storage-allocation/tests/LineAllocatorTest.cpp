@@ -0,0 +1,142 @@
+#include "LineAllocator.h"
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    uintptr_t lineOf(const char *address)
+    {
+        return uintptr_t(address) >> LineAllocator::LineOrder;
+    }
+}
+
+TEST(LineAllocator, LocalsNeverShareALine)
+{
+    BuddyAllocator heap(12);
+    LockedAllocator allocator(heap);
+    LineAllocator lines(allocator);
+    LineAllocator::Local first(lines);
+    LineAllocator::Local second(lines);
+
+    std::vector<char*> blocks[2];
+    for (int i = 0; i < 40; ++i) {
+        uint16_t bytes = uint16_t(1 + i % 32);
+        blocks[0].push_back(first.alloc(bytes));
+        blocks[1].push_back(second.alloc(bytes));
+
+        // aligned to its rounded size, like a buddy block would be
+        EXPECT_EQ(uintptr_t(blocks[0].back()) % (bytes > 16 ? 32 : bytes > 8 ? 16 : 8), 0u);
+    }
+
+    std::set<uintptr_t> firstLines;
+    for (char *address : blocks[0]) {
+        firstLines.insert(lineOf(address));
+    }
+    for (char *address : blocks[1]) {
+        EXPECT_EQ(firstLines.count(lineOf(address)), 0u);
+    }
+
+    for (auto &own : blocks) {
+        for (char *address : own) {
+            lines.free(address);
+        }
+    }
+}
+
+TEST(LineAllocator, DetachedLinesGoBackOnceEmptied)
+{
+    BuddyAllocator heap(12);
+    LockedAllocator allocator(heap);
+    LineAllocator lines(allocator);
+
+    {
+        LineAllocator::Local local(lines);
+
+        std::vector<char*> full;
+        for (int i = 0; i < 8; ++i) {
+            full.push_back(local.alloc(8));
+        }
+        EXPECT_EQ(lines.lines(), 1u);
+
+        // no room left, so the first line is detached but stays until its blocks are freed
+        char *next = local.alloc(8);
+        EXPECT_NE(lineOf(next), lineOf(full[0]));
+        EXPECT_EQ(lines.lines(), 2u);
+
+        for (char *address : full) {
+            lines.free(address);
+        }
+        EXPECT_EQ(lines.lines(), 1u);
+
+        // the owner still holds the second line after its only block is gone
+        local.free(next);
+        EXPECT_EQ(lines.lines(), 1u);
+    }
+
+    EXPECT_EQ(lines.lines(), 0u);
+    EXPECT_EQ(heap.stats().largestFree, 4096u);
+}
+
+TEST(LineAllocator, LargeAndZeroSizedRequestsGoToTheHeap)
+{
+    BuddyAllocator heap(12);
+    LockedAllocator allocator(heap);
+    LineAllocator lines(allocator);
+    LineAllocator::Local local(lines);
+
+    char *large = local.alloc(40);
+    EXPECT_EQ(heap.blockSize(large), 64u);
+    EXPECT_EQ(lines.lines(), 0u);
+    EXPECT_ANY_THROW(local.alloc(0));
+
+    local.free(large);
+    EXPECT_EQ(heap.stats().largestFree, 4096u);
+}
+
+TEST(LineAllocator, FreeingInsideABlockThrows)
+{
+    BuddyAllocator heap(12);
+    LockedAllocator allocator(heap);
+    LineAllocator lines(allocator);
+    LineAllocator::Local local(lines);
+
+    char *block = local.alloc(32);
+    EXPECT_ANY_THROW(lines.free(block + 8));
+    lines.free(block);
+}
+
+TEST(LineAllocator, BlocksCanBeFreedFromAnyThread)
+{
+    BuddyAllocator heap(16);
+    LockedAllocator allocator(heap);
+    LineAllocator lines(allocator);
+
+    const int Threads = 4;
+    std::vector<char*> handed[Threads];
+    {
+        LineAllocator::Local local(lines);
+        for (int i = 0; i < 2400; ++i) {
+            handed[i % Threads].push_back(local.alloc(uint16_t(8 << (i % 3))));
+        }
+    }
+
+    // the owner is gone, every line is detached, and whichever thread empties one hands it back
+    std::vector<std::thread> threads;
+    for (int t = 0; t < Threads; ++t) {
+        threads.emplace_back([&, t] {
+            for (char *address : handed[t]) {
+                lines.free(address);
+            }
+        });
+    }
+    for (auto && thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(lines.lines(), 0u);
+    EXPECT_EQ(heap.stats().largestFree, 65536u);
+}
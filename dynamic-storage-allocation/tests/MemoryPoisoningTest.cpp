@@ -0,0 +1,59 @@
+#include "BuddyAllocator.h"
+#include "MemoryPoisoning.h"
+
+#include <gtest/gtest.h>
+
+#ifndef BUDDY_ASAN
+#  error "built with -fsanitize=address, so the arena should be poisoned"
+#endif
+
+namespace
+{
+    char touch(const char *address)
+    {
+        return *static_cast<const volatile char*>(address);
+    }
+}
+
+TEST(MemoryPoisoning, ReadingAFreedBlockIsReported)
+{
+    BuddyAllocator heap(12);
+    char *keep = heap.alloc(64);
+    char *block = heap.alloc(64);
+    touch(block);
+    heap.free(block);
+
+    EXPECT_DEATH(touch(block), "AddressSanitizer: use-after-poison");
+    EXPECT_DEATH(touch(block + 63), "AddressSanitizer: use-after-poison");
+    heap.free(keep);
+}
+
+TEST(MemoryPoisoning, ReadingPastTheRequestIsReportedInsideTheBlock)
+{
+    BuddyAllocator heap(12);
+
+    // 20 bytes round up to a block of 32, of which only the first 20 may be read
+    char *block = heap.alloc(20);
+    EXPECT_EQ(heap.blockSize(block), 32u);
+    for (int i = 0; i < 20; ++i) {
+        touch(block + i);
+    }
+
+    EXPECT_DEATH(touch(block + 20), "AddressSanitizer: use-after-poison");
+    EXPECT_DEATH(touch(block + 31), "AddressSanitizer: use-after-poison");
+    heap.free(block);
+}
+
+TEST(MemoryPoisoning, AReservedBlockIsReadableAgain)
+{
+    BuddyAllocator heap(12);
+    char *block = heap.alloc(64);
+    heap.free(block);
+
+    char *again = heap.alloc(64);
+    ASSERT_EQ(again, block);
+    for (int i = 0; i < 64; ++i) {
+        touch(again + i);
+    }
+    heap.free(again);
+}
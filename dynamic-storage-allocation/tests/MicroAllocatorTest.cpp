@@ -0,0 +1,99 @@
+#include "MicroAllocator.h"
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <vector>
+
+TEST(MicroAllocator, PacksCellsOfOneSizePerPage)
+{
+    BuddyAllocator heap(12);
+    MicroAllocator micro(heap);
+
+    // 48 one byte cells fill exactly one page, after its header
+    std::set<char*> cells;
+    for (int i = 0; i < 48; ++i) {
+        cells.insert(micro.alloc(1));
+    }
+    EXPECT_EQ(cells.size(), 48u);
+    EXPECT_EQ(*cells.rbegin() - *cells.begin(), 47);
+    EXPECT_EQ((*cells.begin() - heap.base()) % 64, MicroAllocator::HeaderBytes);
+    EXPECT_EQ(micro.pages(), 1u);
+
+    // other sizes get pages of their own, aligned to their size
+    char *word = micro.alloc(3);
+    EXPECT_EQ(micro.pages(), 2u);
+    EXPECT_EQ(uintptr_t(word) % 4, 0u);
+    EXPECT_EQ(micro.liveCells(), 49u);
+
+    micro.free(word);
+    for (char *cell : cells) {
+        micro.free(cell);
+    }
+    EXPECT_EQ(micro.liveCells(), 0u);
+}
+
+TEST(MicroAllocator, EmptyPagesGoBackToTheHeapButTheLast)
+{
+    BuddyAllocator heap(12);
+    MicroAllocator micro(heap);
+
+    std::vector<char*> cells;
+    for (int i = 0; i < 3 * 12; ++i) {
+        cells.push_back(micro.alloc(4));
+    }
+    EXPECT_EQ(micro.pages(), 3u);
+
+    for (char *cell : cells) {
+        micro.free(cell);
+    }
+    EXPECT_EQ(micro.pages(), 1u);
+}
+
+TEST(MicroAllocator, LargerRequestsGoToTheHeap)
+{
+    BuddyAllocator heap(12);
+    MicroAllocator micro(heap);
+
+    char *block = micro.alloc(5);
+    EXPECT_EQ(heap.blockSize(block), 8u);
+    EXPECT_EQ(micro.pages(), 0u);
+    micro.free(block);
+    EXPECT_EQ(heap.stats().largestFree, 4096u);
+}
+
+TEST(MicroAllocator, DoubleFreeOfACellThrows)
+{
+    BuddyAllocator heap(12);
+    MicroAllocator micro(heap);
+
+    char *keep = micro.alloc(2);
+    char *cell = micro.alloc(2);
+    micro.free(cell);
+    EXPECT_ANY_THROW(micro.free(cell));
+    micro.free(keep);
+}
+
+TEST(MicroAllocator, FreeingAHeaderOrBetweenCellsThrows)
+{
+    BuddyAllocator heap(12);
+    MicroAllocator micro(heap);
+
+    char *cell = micro.alloc(4);
+    char *page = cell - MicroAllocator::HeaderBytes;
+    EXPECT_ANY_THROW(micro.free(page));
+    EXPECT_ANY_THROW(micro.free(cell + 2));
+    micro.free(cell);
+}
+
+TEST(MicroAllocator, BookkeepingIsOneBitPerPageBesideTheArena)
+{
+    BuddyAllocator heap(16);
+    MicroAllocator micro(heap);
+    EXPECT_EQ(micro.indexBytes(), heap.capacity() / 512);
+
+    // the headers live in the pages, so only pages in use take any more than that
+    char *cell = micro.alloc(1);
+    EXPECT_EQ(heap.stats().liveBytes, 64u);
+    micro.free(cell);
+}
@@ -0,0 +1,125 @@
+#include "MobilityAllocator.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace
+{
+    uint32_t regionOf(const BuddyAllocator &heap, const char *address, uint8_t regionOrder)
+    {
+        return uint32_t(uint64_t(address - heap.base()) >> regionOrder);
+    }
+}
+
+TEST(MobilityAllocator, MobilitiesClaimTheirOwnRegions)
+{
+    BuddyAllocator heap(12);
+    MobilityAllocator allocator(heap, 9);
+
+    char *movable = allocator.alloc(16, MobilityAllocator::Mobility::Movable);
+    char *unmovable = allocator.alloc(16);
+    char *reclaimable = allocator.alloc(16, MobilityAllocator::Mobility::Reclaimable);
+    char *second = allocator.alloc(16, MobilityAllocator::Mobility::Movable);
+
+    EXPECT_NE(regionOf(heap, movable, 9), regionOf(heap, unmovable, 9));
+    EXPECT_NE(regionOf(heap, movable, 9), regionOf(heap, reclaimable, 9));
+    EXPECT_NE(regionOf(heap, unmovable, 9), regionOf(heap, reclaimable, 9));
+    EXPECT_EQ(regionOf(heap, movable, 9), regionOf(heap, second, 9));
+    EXPECT_EQ(allocator.counters().claims, 3u);
+    EXPECT_EQ(allocator.counters().fallbacks, 0u);
+
+    for (char *address : { movable, unmovable, reclaimable, second }) {
+        allocator.free(address);
+    }
+    EXPECT_EQ(heap.stats().largestFree, 4096u);
+}
+
+TEST(MobilityAllocator, EmptyRegionsLoseTheirLabel)
+{
+    BuddyAllocator heap(12);
+    MobilityAllocator allocator(heap, 11);
+
+    // a movable half and a whole-region block, which takes no label. Once the movable half is empty unmovable blocks
+    // can claim it
+    char *movable = allocator.alloc(16, MobilityAllocator::Mobility::Movable);
+    char *unmovable = allocator.alloc(2000);
+    allocator.free(movable);
+
+    char *next = allocator.alloc(1000);
+    EXPECT_EQ(regionOf(heap, next, 11), regionOf(heap, movable, 11));
+    EXPECT_EQ(allocator.counters().claims, 2u);
+    EXPECT_EQ(allocator.counters().fallbacks, 0u);
+
+    allocator.free(next);
+    allocator.free(unmovable);
+}
+
+TEST(MobilityAllocator, FallsBackWhenNothingElseIsLeft)
+{
+    BuddyAllocator heap(12);
+    MobilityAllocator allocator(heap, 11);
+
+    char *movable = allocator.alloc(16, MobilityAllocator::Mobility::Movable);
+    char *reclaimable = allocator.alloc(16, MobilityAllocator::Mobility::Reclaimable);
+
+    // no unmovable region and no free one, reclaimable is the preferred victim
+    char *unmovable = allocator.alloc(16);
+    EXPECT_EQ(regionOf(heap, unmovable, 11), regionOf(heap, reclaimable, 11));
+    EXPECT_EQ(allocator.counters().fallbacks, 1u);
+
+    for (char *address : { movable, reclaimable, unmovable }) {
+        allocator.free(address);
+    }
+}
+
+TEST(MobilityAllocator, FreesMappedAndWholeRegionBlocks)
+{
+    BuddyAllocator heap(12);
+    heap.mapLargeAllocations(4096);
+    MobilityAllocator allocator(heap, 10);
+
+    char *small = allocator.alloc(16, MobilityAllocator::Mobility::Movable);
+    char *region = allocator.alloc(1024);
+    char *mapped = allocator.alloc(8192);
+    EXPECT_FALSE(heap.inArena(mapped));
+
+    allocator.free(mapped);
+    allocator.free(region);
+    allocator.free(small);
+    EXPECT_EQ(heap.stats().largestFree, 4096u);
+    EXPECT_EQ(allocator.counters().claims, 1u);
+}
+
+TEST(MobilityAllocator, UnmovableBlocksFromAPeakLeaveTheOtherRegionsWhole)
+{
+    // a peak of movable blocks with the odd unmovable one in between, after which the movable ones go again
+    auto peak = [](BuddyAllocator &heap, Allocator &allocator, bool grouped) {
+        std::vector<char*> movable, unmovable;
+        for (int i = 0; i < 48; ++i) {
+            movable.push_back(grouped ? static_cast<MobilityAllocator&>(allocator).alloc(64, MobilityAllocator::Mobility::Movable)
+                                      : allocator.alloc(64));
+            if (i % 8 == 7) {
+                unmovable.push_back(allocator.alloc(16));
+            }
+        }
+        for (char *address : movable) {
+            allocator.free(address);
+        }
+
+        uint32_t largest = heap.stats().largestFree;
+        for (char *address : unmovable) {
+            allocator.free(address);
+        }
+        return largest;
+    };
+
+    BuddyAllocator plain(12);
+    EXPECT_LT(peak(plain, plain, false), 2048u);
+
+    // the default is a quarter of the arena, and every unmovable block went into a single quarter
+    BuddyAllocator heap(12);
+    MobilityAllocator allocator(heap);
+    EXPECT_EQ(peak(heap, allocator, true), 2048u);
+    EXPECT_EQ(heap.stats().largestFree, 4096u);
+}
@@ -0,0 +1,125 @@
+#include "PerCpuCache.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <set>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__linux__) && __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#endif
+
+// every test runs with rseq, where the kernel and C library have it, and with the flag based fallback
+class PerCpuCacheTest : public testing::TestWithParam<bool>
+{
+};
+
+TEST_P(PerCpuCacheTest, FreedBlocksComeBackFromTheCache)
+{
+    BuddyAllocator heap(12);
+    LockedAllocator allocator(heap);
+    PerCpuCache cache(allocator, 10, GetParam());
+
+    char *first = cache.alloc(24);
+    EXPECT_EQ(heap.blockSize(first), 32u);
+    cache.free(first);
+
+    // still reserved in the heap, but ours to hand out again. Nothing migrates us on the way, or this would be flaky
+    EXPECT_LT(heap.stats().largestFree, 4096u);
+    EXPECT_EQ(cache.alloc(32), first);
+    cache.free(first);
+
+    cache.flush();
+    EXPECT_EQ(heap.stats().largestFree, 4096u);
+}
+
+TEST_P(PerCpuCacheTest, FullMagazinesGiveHalfBack)
+{
+    BuddyAllocator heap(12);
+    LockedAllocator allocator(heap);
+    PerCpuCache cache(allocator, 10, GetParam());
+
+    std::vector<char*> blocks;
+    for (size_t i = 0; i <= PerCpuCache::MagazineSize; ++i) {
+        blocks.push_back(cache.alloc(64));
+    }
+    for (char *address : blocks) {
+        cache.free(address);
+    }
+
+    // half a magazine and the block that overflowed it are left, and come back out first
+    std::set<char*> cached;
+    for (size_t i = 0; i < PerCpuCache::MagazineSize / 2 + 1; ++i) {
+        cached.insert(cache.alloc(64));
+    }
+    EXPECT_EQ(cached.size(), PerCpuCache::MagazineSize / 2 + 1);
+    for (char *address : cached) {
+        EXPECT_NE(std::find(blocks.begin(), blocks.end(), address), blocks.end());
+        cache.free(address);
+    }
+
+    cache.flush();
+    EXPECT_EQ(heap.stats().largestFree, 4096u);
+}
+
+TEST_P(PerCpuCacheTest, LargeAndZeroSizedRequests)
+{
+    BuddyAllocator heap(12);
+    LockedAllocator allocator(heap);
+    PerCpuCache cache(allocator, 8, GetParam());
+
+    // like the heap underneath, nothing is handed out for nothing
+    EXPECT_ANY_THROW(cache.alloc(0));
+
+    char *large = cache.alloc(1024);
+    cache.free(large);
+    EXPECT_EQ(heap.stats().largestFree, 4096u);
+}
+
+TEST_P(PerCpuCacheTest, ManyThreadsShareTheCaches)
+{
+    BuddyAllocator heap(16);
+    LockedAllocator allocator(heap);
+    PerCpuCache cache(allocator, 10, GetParam());
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 32; ++t) {
+        threads.emplace_back([&, t] {
+            char *live[8] = {};
+            for (int i = 0; i < 20000; ++i) {
+                char *&slot = live[(i + t) % 8];
+                if (slot) {
+                    cache.free(slot);
+                }
+                slot = cache.alloc(uint16_t(8 << ((i + t) % 5)));
+                slot[0] = char(t);
+            }
+            for (char *address : live) {
+                cache.free(address);
+            }
+        });
+    }
+    for (auto && thread : threads) {
+        thread.join();
+    }
+
+    // a block handed out twice would have thrown on its second free by now, or be missing here
+    cache.flush();
+    EXPECT_EQ(heap.stats().largestFree, 65536u);
+}
+
+INSTANTIATE_TEST_SUITE_P(Rseq, PerCpuCacheTest, testing::Values(true, false),
+                         [](const testing::TestParamInfo<bool> &info) { return info.param ? "Rseq" : "Fallback"; });
+
+TEST(PerCpuCache, UsesRseqWhereAvailable)
+{
+    BuddyAllocator heap(12);
+    LockedAllocator allocator(heap);
+
+    EXPECT_FALSE(PerCpuCache(allocator, 10, false).usesRseq());
+#if defined(__x86_64__) && defined(__linux__) && __has_include(<sys/rseq.h>)
+    EXPECT_EQ(PerCpuCache(allocator).usesRseq(), __rseq_size > 0);
+#endif
+}
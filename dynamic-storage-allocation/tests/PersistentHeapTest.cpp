@@ -0,0 +1,108 @@
+#include "PersistentHeap.h"
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace
+{
+    struct HeapFile
+    {
+        std::string path = "/tmp/persistent-heap." + std::to_string(getpid());
+
+        HeapFile() { remove(path.c_str()); }
+        ~HeapFile() { remove(path.c_str()); }
+
+        // the tags start on the page after the header, see the layout in the PersistentHeap constructor
+        off_t tagsOffset() const { return sysconf(_SC_PAGESIZE); }
+
+        void patch(off_t offset, const void *bytes, size_t count)
+        {
+            int fd = open(path.c_str(), O_WRONLY);
+            ASSERT_GE(fd, 0);
+            ASSERT_EQ(pwrite(fd, bytes, count, offset), ssize_t(count));
+            close(fd);
+        }
+    };
+}
+
+TEST(PersistentHeap, BlocksSurviveReopening)
+{
+    HeapFile file;
+    ptrdiff_t a, b;
+
+    {
+        PersistentHeap heap(file.path, 16);
+        char *first = heap.alloc(100);
+        char *second = heap.alloc(3000);
+        strcpy(second, "still here");
+        heap.free(heap.alloc(8));
+        a = first - heap.base();
+        b = second - heap.base();
+    }
+
+    PersistentHeap heap(file.path, 16);
+    EXPECT_STREQ(heap.base() + b, "still here");
+
+    // both are still reserved, so nothing new may overlap them
+    char *next = heap.alloc(100);
+    EXPECT_NE(next - heap.base(), a);
+    heap.free(heap.base() + a);
+    heap.free(heap.base() + b);
+    heap.free(next);
+    EXPECT_ANY_THROW(heap.free(heap.base() + a));
+}
+
+TEST(PersistentHeap, RecoveryReplaysTheRedoLog)
+{
+    HeapFile file;
+    ptrdiff_t offset;
+
+    {
+        PersistentHeap heap(file.path, 12);
+        offset = heap.alloc(8) - heap.base();
+    }
+
+    // a crash after the log was written but before any tag was: the tags still describe one free 2^12 block
+    std::vector<uint8_t> fresh(size_t(1) << (12 - 3), 0);
+    fresh[0] = 0x80 | 12;
+    file.patch(file.tagsOffset(), fresh.data(), fresh.size());
+
+    PersistentHeap heap(file.path, 12);
+    EXPECT_NO_THROW(heap.free(heap.base() + offset));
+    EXPECT_ANY_THROW(heap.free(heap.base() + offset));
+}
+
+TEST(PersistentHeap, TornLogIsIgnored)
+{
+    HeapFile file;
+    ptrdiff_t offset;
+
+    {
+        PersistentHeap heap(file.path, 12);
+        offset = heap.alloc(8) - heap.base();
+    }
+
+    // a crash while the log was being written: the tags were never touched and the checksum does not match
+    std::vector<uint8_t> fresh(size_t(1) << (12 - 3), 0);
+    fresh[0] = 0x80 | 12;
+    file.patch(file.tagsOffset(), fresh.data(), fresh.size());
+    uint32_t checksum = 0xdeadbeef;
+    file.patch(12, &checksum, sizeof(checksum));
+
+    PersistentHeap heap(file.path, 12);
+    EXPECT_ANY_THROW(heap.free(heap.base() + offset));
+    EXPECT_NE(heap.alloc(4096), nullptr);             // the whole heap is free again
+}
+
+TEST(PersistentHeap, RejectsAHeapOfAnotherSize)
+{
+    HeapFile file;
+    {
+        PersistentHeap heap(file.path, 12);
+    }
+    EXPECT_ANY_THROW(PersistentHeap(file.path, 13));
+}
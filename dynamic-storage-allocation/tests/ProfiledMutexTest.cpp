@@ -0,0 +1,65 @@
+#include "ProfiledMutex.h"
+#include "LockedAllocator.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+TEST(ProfiledMutex, CountsUncontendedAcquisitionsAndHoldTime)
+{
+    ProfiledMutex mutex;
+
+    {
+        std::lock_guard<ProfiledMutex> guard(mutex);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    ASSERT_TRUE(mutex.try_lock());
+    mutex.unlock();
+
+    ProfiledMutex::Stats stats = mutex.stats();
+    EXPECT_EQ(stats.acquisitions, 2u);
+    EXPECT_EQ(stats.contended, 0u);
+    EXPECT_EQ(stats.waitNanos, 0u);
+    EXPECT_GE(stats.maxHoldNanos, 2000000u);
+    EXPECT_GE(stats.holdNanos, stats.maxHoldNanos);
+}
+
+TEST(ProfiledMutex, TimesTheWaitOfAContendedLock)
+{
+    ProfiledMutex mutex;
+    std::atomic<bool> waiting(false);
+
+    mutex.lock();
+    std::thread waiter([&] {
+        waiting = true;
+        std::lock_guard<ProfiledMutex> guard(mutex);
+    });
+    while (!waiting) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_FALSE(mutex.try_lock());
+    mutex.unlock();
+    waiter.join();
+
+    ProfiledMutex::Stats stats = mutex.stats();
+    EXPECT_EQ(stats.acquisitions, 2u);
+    EXPECT_EQ(stats.contended, 1u);
+
+    // a few milliseconds is past every bucket but the last
+    EXPECT_EQ(stats.wait[ProfiledMutex::WaitBuckets - 1], 1u);
+    EXPECT_GE(stats.waitNanos, 1000000u);
+}
+
+TEST(ProfiledMutex, LockedAllocatorCountsEveryCall)
+{
+    BuddyAllocator heap(10);
+    LockedAllocator allocator(heap);
+
+    char *blocks[2] = { allocator.alloc(8), allocator.alloc(8) };
+    allocator.freeBatch(blocks, 2);
+
+    EXPECT_EQ(allocator.lockStats().acquisitions, 3u);
+    EXPECT_EQ(allocator.lockStats().contended, 0u);
+}
@@ -0,0 +1,208 @@
+#include "PrometheusExporter.h"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <map>
+#include <set>
+#include <signal.h>
+#include <sstream>
+#include <stdio.h>
+#include <unistd.h>
+
+namespace
+{
+    // just enough of the text exposition format: comments, and samples of the form name{labels} value
+    struct Exposition
+    {
+        std::map<std::string, std::string> types;      // metric family -> type
+        std::map<std::string, double> samples;          // name{labels} -> value
+        std::vector<std::string> order;                 // sample keys as they appeared
+    };
+
+    Exposition parse(const std::string &text)
+    {
+        Exposition exposition;
+        std::istringstream in(text);
+        std::string line;
+
+        while (std::getline(in, line)) {
+            EXPECT_FALSE(line.empty());
+
+            if (line.compare(0, 7, "# TYPE ") == 0) {
+                std::istringstream fields(line.substr(7));
+                std::string name, type;
+                fields >> name >> type;
+                EXPECT_TRUE(type == "gauge" || type == "counter" || type == "histogram") << line;
+                EXPECT_EQ(exposition.types.count(name), 0u) << "declared twice: " << name;
+                exposition.types[name] = type;
+                continue;
+            }
+            if (line[0] == '#') {
+                EXPECT_EQ(line.compare(0, 7, "# HELP "), 0) << line;
+                continue;
+            }
+
+            size_t space = line.rfind(' ');
+            EXPECT_NE(space, std::string::npos) << line;
+            std::string key = line.substr(0, space);
+
+            // the whole value has to be a number
+            const char *value = line.c_str() + space + 1;
+            char *end = nullptr;
+            double number = strtod(value, &end);
+            EXPECT_EQ(*end, '\0') << line;
+
+            std::string name = key.substr(0, key.find('{'));
+            std::string family = name;
+            for (const char *suffix : { "_bucket", "_sum", "_count" }) {
+                size_t at = name.size() - strlen(suffix);
+                if (name.size() > strlen(suffix) && name.compare(at, std::string::npos, suffix) == 0 && exposition.types.count(name.substr(0, at))) {
+                    family = name.substr(0, at);
+                }
+            }
+            EXPECT_EQ(exposition.types.count(family), 1u) << "no TYPE for " << name;
+
+            EXPECT_EQ(exposition.samples.count(key), 0u) << "duplicate sample " << key;
+            exposition.samples[key] = number;
+            exposition.order.push_back(key);
+        }
+
+        return exposition;
+    }
+
+    std::string render(const PrometheusExporter &exporter)
+    {
+        std::ostringstream out;
+        exporter.write(out);
+        return out.str();
+    }
+
+    // buckets have to be cumulative and end in +Inf, which has to equal _count
+    void expectHistogram(const Exposition &exposition, const std::string &name, const std::string &labels)
+    {
+        double previous = 0;
+        bool infinite = false;
+        for (auto && key : exposition.order) {
+            if (key.compare(0, name.size() + 8, name + "_bucket{") != 0 || key.find(labels) == std::string::npos) {
+                continue;
+            }
+            EXPECT_FALSE(infinite) << "bucket after +Inf: " << key;
+            EXPECT_GE(exposition.samples.at(key), previous) << key;
+            previous = exposition.samples.at(key);
+            infinite = key.find("le=\"+Inf\"") != std::string::npos;
+        }
+        EXPECT_TRUE(infinite) << name;
+
+        std::string count = name + "_count" + (labels.empty() ? "" : "{" + labels + "}");
+        ASSERT_EQ(exposition.samples.count(count), 1u) << count;
+        EXPECT_EQ(exposition.samples.at(count), previous);
+    }
+
+    std::string temporaryPath(const char *name)
+    {
+        return std::string("/tmp/") + name + "." + std::to_string(getpid()) + ".prom";
+    }
+
+    bool waitForFile(const std::string &path)
+    {
+        for (int i = 0; i < 300; ++i) {
+            if (std::ifstream(path.c_str())) {
+                return true;
+            }
+            usleep(10000);
+        }
+        return false;
+    }
+}
+
+TEST(PrometheusExporter, OutputParsesAndMatchesTheStats)
+{
+    BuddyAllocator allocator(12);
+    allocator.measureLatency(true);
+
+    char *a = allocator.alloc(16);
+    char *b = allocator.alloc(16);
+    char *c = allocator.alloc(100);
+    allocator.tryAlloc(8192);
+
+    PrometheusExporter exporter(allocator, "/dev/null");
+    Exposition exposition = parse(render(exporter));
+
+    EXPECT_EQ(exposition.types["buddy_free_blocks"], "gauge");
+    EXPECT_EQ(exposition.types["buddy_splits_total"], "counter");
+    EXPECT_EQ(exposition.types["buddy_alloc_latency_seconds"], "histogram");
+
+    EXPECT_EQ(exposition.samples["buddy_used_blocks{order=\"4\"}"], 2);
+    EXPECT_EQ(exposition.samples["buddy_used_blocks{order=\"7\"}"], 1);
+    EXPECT_EQ(exposition.samples["buddy_live_bytes"], 160);
+    EXPECT_EQ(exposition.samples["buddy_alloc_failures_total"], 1);
+    EXPECT_EQ(exposition.samples["buddy_alloc_near_misses_total"], 0);
+    EXPECT_EQ(exposition.samples["buddy_splits_total"], allocator.stats().splits);
+
+    // the failed allocation is timed as well
+    expectHistogram(exposition, "buddy_alloc_latency_seconds", "");
+    EXPECT_EQ(exposition.samples["buddy_alloc_latency_seconds_count"], 4);
+
+    allocator.free(a);
+    allocator.free(b);
+    allocator.free(c);
+}
+
+TEST(PrometheusExporter, SecondsKeepEveryNanosecond)
+{
+    ProfiledMutex::Stats lock = {};
+    lock.acquisitions = 3;
+    lock.holdNanos = 1234567890123ull;
+    lock.maxHoldNanos = 1;
+
+    BuddyAllocator allocator(8);
+    PrometheusExporter exporter(allocator, "/dev/null");
+    exporter.addLock("arena", [&] { return lock; });
+
+    std::string text = render(exporter);
+    Exposition exposition = parse(text);
+    EXPECT_NE(text.find("buddy_lock_hold_seconds_total{lock=\"arena\"} 1234.567890123\n"), std::string::npos);
+    EXPECT_NE(text.find("buddy_lock_max_hold_seconds{lock=\"arena\"} 0.000000001\n"), std::string::npos);
+    EXPECT_NE(text.find("le=\"0.000000064\""), std::string::npos);
+    expectHistogram(exposition, "buddy_lock_wait_seconds", "lock=\"arena\"");
+}
+
+TEST(PrometheusExporter, DumpReplacesTheFile)
+{
+    BuddyAllocator allocator(8);
+    std::string path = temporaryPath("dump");
+
+    PrometheusExporter exporter(allocator, path);
+    exporter.dump();
+
+    std::ifstream in(path.c_str());
+    std::stringstream text;
+    text << in.rdbuf();
+    EXPECT_EQ(text.str(), render(exporter));
+    EXPECT_FALSE(std::ifstream((path + ".tmp").c_str()));
+
+    remove(path.c_str());
+}
+
+TEST(PrometheusExporter, OneSignalDumpsEveryExporter)
+{
+    BuddyAllocator allocator(8);
+    std::string first = temporaryPath("first"), second = temporaryPath("second");
+    remove(first.c_str());
+    remove(second.c_str());
+
+    PrometheusExporter::installSignalHandler();
+    PrometheusExporter one(allocator, first), other(allocator, second);
+    one.start(std::chrono::hours(1));
+    other.start(std::chrono::hours(1));
+
+    raise(SIGUSR1);
+    EXPECT_TRUE(waitForFile(first));
+    EXPECT_TRUE(waitForFile(second));
+
+    one.stop();
+    other.stop();
+    remove(first.c_str());
+    remove(second.c_str());
+}
@@ -0,0 +1,117 @@
+#include "QuaternaryEngine.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+TEST(QuaternaryEngine, SplitsFourWaysAndMergesBack)
+{
+    QuaternaryEngine engine(10, 4);
+
+    uint64_t a = engine.alloc(4);
+    ASSERT_NE(a, QuaternaryEngine::None);
+    EXPECT_EQ(engine.splits(), 3u);                 // 2^10 down to 2^4, two orders at a time
+    EXPECT_EQ(engine.freeBlocks(4), 3u);
+    EXPECT_EQ(engine.freeBlocks(6), 3u);
+    EXPECT_EQ(engine.freeBlocks(8), 3u);
+
+    // three quarters free is not enough to merge
+    std::vector<uint64_t> quarters;
+    for (int i = 0; i < 3; ++i) {
+        quarters.push_back(engine.alloc(4));
+    }
+    for (uint64_t offset : quarters) {
+        EXPECT_EQ(engine.free(offset), 4);
+    }
+    EXPECT_EQ(engine.coalesces(), 0u);
+
+    EXPECT_EQ(engine.free(a), 4);
+    EXPECT_EQ(engine.coalesces(), 3u);
+    EXPECT_EQ(engine.largestFree(), 10);
+}
+
+TEST(QuaternaryEngine, RoundsUpToEvenOrders)
+{
+    QuaternaryEngine engine(10, 4);
+
+    EXPECT_EQ(engine.orderFor(0), 4);
+    EXPECT_EQ(engine.orderFor(5), 6);
+    EXPECT_EQ(engine.orderFor(6), 6);
+    EXPECT_EQ(engine.orderFor(9), 10);
+
+    uint64_t offset = engine.alloc(7);
+    EXPECT_EQ(engine.orderOf(offset), 8);
+    EXPECT_FALSE(engine.isFree(offset));
+    EXPECT_EQ(engine.alloc(11), QuaternaryEngine::None);
+    engine.free(offset);
+}
+
+TEST(QuaternaryEngine, RejectsOddRangesAndDoubleFrees)
+{
+    EXPECT_ANY_THROW(QuaternaryEngine(9, 4));
+
+    QuaternaryEngine engine(8, 4);
+    uint64_t offset = engine.alloc(4);
+    engine.free(offset);
+    EXPECT_ANY_THROW(engine.free(offset));
+}
+
+TEST(QuaternaryEngine, RejectsFreeingAMergedQuarterAndOutOfRange)
+{
+    QuaternaryEngine engine(8, 4);
+    uint64_t quarters[4];
+    for (auto &offset : quarters) {
+        offset = engine.alloc(4);
+    }
+    EXPECT_ANY_THROW(engine.free(256));
+    EXPECT_ANY_THROW(engine.free(quarters[0] + 8));
+
+    // the last quarter to go merges all four, after which none of them is a block any more
+    for (uint64_t offset : quarters) {
+        engine.free(offset);
+    }
+    for (uint64_t offset : quarters) {
+        EXPECT_ANY_THROW(engine.free(offset));
+    }
+    EXPECT_EQ(engine.largestFree(), 8);
+    EXPECT_EQ(engine.freeBlocks(8), 1u);
+}
+
+TEST(QuaternaryEngine, RandomTraceCoversTheRangeExactly)
+{
+    QuaternaryEngine engine(16, 4);
+    std::mt19937 random(3);
+    std::vector<uint64_t> live;
+
+    for (int i = 0; i < 20000; ++i) {
+        if (!live.empty() && random() % 2) {
+            size_t victim = random() % live.size();
+            engine.free(live[victim]);
+            live[victim] = live.back();
+            live.pop_back();
+        } else {
+            uint64_t offset = engine.alloc(uint8_t(4 + random() % 7));
+            if (offset != QuaternaryEngine::None) {
+                live.push_back(offset);
+            }
+        }
+    }
+
+    // blocks tile the range with no gaps, and exactly the live ones are reserved
+    uint64_t next = 0, reserved = 0;
+    engine.forEachBlock([&](uint64_t offset, uint8_t k, bool available) {
+        EXPECT_EQ(offset, next);
+        EXPECT_EQ(offset & ((uint64_t(1) << k) - 1), 0u);
+        next = offset + (uint64_t(1) << k);
+        reserved += !available;
+    });
+    EXPECT_EQ(next, uint64_t(1) << 16);
+    EXPECT_EQ(reserved, live.size());
+
+    for (uint64_t offset : live) {
+        engine.free(offset);
+    }
+    EXPECT_EQ(engine.largestFree(), 16);
+}
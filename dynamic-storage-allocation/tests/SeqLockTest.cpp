@@ -0,0 +1,93 @@
+#include "BuddyAllocator.h"
+#include "SeqLock.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+namespace
+{
+    struct Pair
+    {
+        uint64_t a;
+        uint64_t b;
+    };
+}
+
+TEST(SeqLock, LoadsWhatWasStored)
+{
+    SeqLock<Pair> lock;
+    EXPECT_EQ(lock.load().a, 0u);
+
+    lock.store(Pair{ 1, 2 });
+    Pair pair = lock.load();
+    EXPECT_EQ(pair.a, 1u);
+    EXPECT_EQ(pair.b, 2u);
+}
+
+TEST(SeqLock, StoresOnlyThePickedWords)
+{
+    SeqLock<Pair> lock;
+    lock.store(Pair{ 1, 2 });
+
+    // b is not picked, so the 2 stays
+    lock.store(Pair{ 3, 4 }, 1);
+    Pair pair = lock.load();
+    EXPECT_EQ(pair.a, 3u);
+    EXPECT_EQ(pair.b, 2u);
+
+    // bits past the last word are ignored
+    lock.store(Pair{ 5, 6 }, ~uint64_t(0));
+    EXPECT_EQ(lock.load().a, 5u);
+    EXPECT_EQ(lock.load().b, 6u);
+}
+
+TEST(SeqLock, ReadersNeverSeeATornValue)
+{
+    SeqLock<Pair> lock;
+    std::atomic<bool> done(false);
+    std::atomic<uint64_t> torn(0);
+
+    std::thread reader([&] {
+        while (!done) {
+            Pair pair = lock.load();
+            if (pair.a != pair.b) {
+                ++torn;
+            }
+        }
+    });
+
+    for (uint64_t i = 1; i <= 200000; ++i) {
+        lock.store(Pair{ i, i });
+    }
+    done = true;
+    reader.join();
+
+    EXPECT_EQ(torn.load(), 0u);
+}
+
+TEST(SeqLock, StatsAreConsistentWhileAllocating)
+{
+    BuddyAllocator allocator(12);
+    std::atomic<bool> done(false);
+    std::atomic<uint64_t> inconsistent(0);
+
+    // every block is 64 bytes, so live bytes always matches the used count
+    std::thread reader([&] {
+        while (!done) {
+            BuddyAllocator::Stats stats = allocator.stats();
+            if (stats.liveBytes != stats.usedBlocks[6] * 64u) {
+                ++inconsistent;
+            }
+        }
+    });
+
+    for (int i = 0; i < 20000; ++i) {
+        allocator.free(allocator.alloc(64));
+    }
+    done = true;
+    reader.join();
+
+    EXPECT_EQ(inconsistent.load(), 0u);
+}
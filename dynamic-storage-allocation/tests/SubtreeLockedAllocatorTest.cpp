@@ -0,0 +1,82 @@
+#include "SubtreeLockedAllocator.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+TEST(SubtreeLockedAllocator, SmallRequestsStayInOneSubtree)
+{
+    SubtreeLockedAllocator allocator(12);
+    EXPECT_EQ(allocator.subtrees(), 8u);
+
+    // eight subtrees of 512 bytes: sixteen 32 byte blocks fill the thread's own, the next one spills
+    std::vector<char*> blocks;
+    for (int i = 0; i < 16; ++i) {
+        blocks.push_back(allocator.alloc(32));
+        EXPECT_EQ((blocks.back() - blocks.front()) >> 9, 0);
+    }
+    EXPECT_EQ(allocator.counters().spills, 0u);
+
+    blocks.push_back(allocator.alloc(32));
+    EXPECT_NE((blocks.back() - blocks.front()) >> 9, 0);
+    EXPECT_EQ(allocator.counters().spills, 1u);
+
+    for (char *address : blocks) {
+        allocator.free(address);
+    }
+}
+
+TEST(SubtreeLockedAllocator, EmptySubtreesAreTakenBackForLargeRequests)
+{
+    SubtreeLockedAllocator allocator(12);
+
+    char *small = allocator.alloc(8);
+    allocator.free(small);
+
+    // the subtree is still borrowed but empty, so the whole arena can be had again
+    char *whole = allocator.alloc(4096);
+    EXPECT_GT(allocator.counters().globalSteps, 0u);
+    EXPECT_ANY_THROW(allocator.alloc(8));
+    allocator.free(whole);
+
+    char *again = allocator.alloc(8);
+    allocator.free(again);
+}
+
+TEST(SubtreeLockedAllocator, RejectsWhatItDidNotHandOut)
+{
+    SubtreeLockedAllocator allocator(12);
+    char elsewhere[8];
+
+    EXPECT_ANY_THROW(allocator.alloc(0));
+    EXPECT_ANY_THROW(allocator.alloc(8192));
+    EXPECT_ANY_THROW(allocator.free(elsewhere));
+}
+
+TEST(SubtreeLockedAllocator, ThreadsChurningTogetherLeaveTheArenaWhole)
+{
+    SubtreeLockedAllocator allocator(14);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            char *live[8] = {};
+            for (int i = 0; i < 20000; ++i) {
+                if (live[i % 8]) {
+                    allocator.free(live[i % 8]);
+                }
+                live[i % 8] = allocator.alloc(uint16_t(16 << (i % 4)));
+            }
+            for (char *address : live) {
+                allocator.free(address);
+            }
+        });
+    }
+    for (auto && thread : threads) {
+        thread.join();
+    }
+
+    char *whole = allocator.alloc(16384);
+    allocator.free(whole);
+}
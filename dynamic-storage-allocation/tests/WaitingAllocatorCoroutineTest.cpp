@@ -0,0 +1,87 @@
+#include "WaitingAllocator.h"
+
+#include <gtest/gtest.h>
+
+#include <exception>
+#include <thread>
+#include <vector>
+
+#ifndef WAITINGALLOCATOR_COROUTINES
+#  error "built as C++20, so allocAsync should be there"
+#endif
+
+namespace
+{
+    // runs eagerly up to the first co_await, and nobody ever waits for it to finish
+    struct Detached
+    {
+        struct promise_type
+        {
+            Detached get_return_object() { return {}; }
+            std::suspend_never initial_suspend() { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+    struct Served
+    {
+        int who;
+        char *address;
+        std::thread::id on;
+    };
+
+    Detached request(WaitingAllocator &allocator, uint16_t bytes, int who, std::vector<Served> &served)
+    {
+        char *address = co_await allocator.allocAsync(bytes);
+        served.push_back({ who, address, std::this_thread::get_id() });
+    }
+}
+
+TEST(WaitingAllocatorCoroutines, ResumedInOrderOnTheFreeingThread)
+{
+    BuddyAllocator heap(10);
+    WaitingAllocator allocator(heap);
+    std::vector<Served> served;
+
+    char *all = allocator.alloc(1024);
+    request(allocator, 512, 0, served);
+    request(allocator, 512, 1, served);
+    request(allocator, 8, 2, served);
+    EXPECT_TRUE(served.empty());
+
+    // room for the first two, the third has to wait behind them even though it is the smallest
+    std::thread::id freeing;
+    std::thread freer([&] {
+        freeing = std::this_thread::get_id();
+        allocator.free(all);
+    });
+    freer.join();
+
+    ASSERT_EQ(served.size(), 2u);
+    EXPECT_EQ(served[0].who, 0);
+    EXPECT_EQ(served[1].who, 1);
+    EXPECT_EQ(served[0].on, freeing);
+    EXPECT_EQ(served[1].on, freeing);
+
+    allocator.free(served[0].address);
+    ASSERT_EQ(served.size(), 3u);
+    EXPECT_EQ(served[2].who, 2);
+    EXPECT_EQ(served[2].on, std::this_thread::get_id());
+
+    allocator.free(served[1].address);
+    allocator.free(served[2].address);
+}
+
+TEST(WaitingAllocatorCoroutines, DoesNotSuspendWhenThereIsRoom)
+{
+    BuddyAllocator heap(10);
+    WaitingAllocator allocator(heap);
+    std::vector<Served> served;
+
+    request(allocator, 64, 0, served);
+    ASSERT_EQ(served.size(), 1u);
+    EXPECT_NE(served[0].address, nullptr);
+    allocator.free(served[0].address);
+}
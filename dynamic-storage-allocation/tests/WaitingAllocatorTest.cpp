@@ -0,0 +1,134 @@
+#include "WaitingAllocator.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+namespace
+{
+    // long enough for a thread that was just started to be waiting in the queue
+    void letWaitersQueueUp()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+}
+
+TEST(WaitingAllocator, AllocWaitsForAFree)
+{
+    BuddyAllocator heap(10);
+    WaitingAllocator allocator(heap);
+
+    char *all = allocator.alloc(1024);
+    std::atomic<char*> got(nullptr);
+    std::thread waiter([&] { got = allocator.alloc(512); });
+
+    letWaitersQueueUp();
+    EXPECT_EQ(got.load(), nullptr);
+
+    allocator.free(all);
+    waiter.join();
+    EXPECT_NE(got.load(), nullptr);
+    allocator.free(got);
+}
+
+TEST(WaitingAllocator, AllocForTimesOut)
+{
+    BuddyAllocator heap(10);
+    WaitingAllocator allocator(heap);
+
+    char *all = allocator.alloc(1024);
+    EXPECT_EQ(allocator.allocFor(8, std::chrono::milliseconds(20)), nullptr);
+
+    allocator.free(all);
+    char *some = allocator.allocFor(8, std::chrono::milliseconds(20));
+    EXPECT_NE(some, nullptr);
+    allocator.free(some);
+}
+
+TEST(WaitingAllocator, TooLargeThrowsRightAway)
+{
+    BuddyAllocator heap(10);
+    WaitingAllocator allocator(heap);
+    EXPECT_ANY_THROW(allocator.alloc(2048));
+}
+
+TEST(WaitingAllocator, NewcomersDoNotOvertake)
+{
+    BuddyAllocator heap(10);
+    WaitingAllocator allocator(heap);
+
+    char *half = allocator.alloc(512);
+    char *quarter = allocator.alloc(256);
+
+    std::atomic<int> served(0);
+    int largeTurn = 0, smallTurn = 0;
+    char *large = nullptr, *small = nullptr;
+
+    // the large request is first in line; the small one would fit in the free quarter but has to wait its turn
+    std::thread first([&] { large = allocator.alloc(512); largeTurn = ++served; });
+    letWaitersQueueUp();
+    std::thread second([&] { small = allocator.alloc(8); smallTurn = ++served; });
+    letWaitersQueueUp();
+    EXPECT_EQ(served.load(), 0);
+
+    allocator.free(half);
+    first.join();
+    second.join();
+
+    EXPECT_EQ(largeTurn, 1);
+    EXPECT_EQ(smallTurn, 2);
+
+    allocator.free(large);
+    allocator.free(small);
+    allocator.free(quarter);
+}
+
+TEST(WaitingAllocator, ATimedOutFrontLetsTheRestThrough)
+{
+    BuddyAllocator heap(10);
+    WaitingAllocator allocator(heap);
+
+    char *half = allocator.alloc(512);
+    char *quarter = allocator.alloc(256);
+    char *small = nullptr;
+
+    std::thread first([&] { EXPECT_EQ(allocator.allocFor(1024, std::chrono::milliseconds(100)), nullptr); });
+    letWaitersQueueUp();
+    std::thread second([&] { small = allocator.alloc(8); });
+
+    first.join();
+    second.join();
+    EXPECT_NE(small, nullptr);
+
+    allocator.free(small);
+    allocator.free(quarter);
+    allocator.free(half);
+}
+
+TEST(WaitingAllocator, HopelessRequestsThrowEvenBehindAWaiter)
+{
+    BuddyAllocator heap(10);
+    WaitingAllocator allocator(heap);
+
+    char *all = allocator.alloc(1024);
+    char *queued = nullptr;
+    std::thread waiter([&] { queued = allocator.alloc(512); });
+    letWaitersQueueUp();
+
+    // neither may join the queue: the first could never be served, the second would throw out of somebody's free
+    EXPECT_ANY_THROW(allocator.alloc(2048));
+    EXPECT_ANY_THROW(allocator.allocFor(2048, std::chrono::milliseconds(1000)));
+    EXPECT_ANY_THROW(allocator.alloc(0));
+
+    allocator.free(all);
+    waiter.join();
+    ASSERT_NE(queued, nullptr);
+
+    // and nobody was left in front of a later request
+    char *later = allocator.allocFor(16, std::chrono::milliseconds(1000));
+    EXPECT_NE(later, nullptr);
+
+    allocator.free(later);
+    allocator.free(queued);
+}